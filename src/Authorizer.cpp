@@ -0,0 +1,206 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "Authorizer.h"
+
+#include "Log.h"
+
+#include <QCoreApplication>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QSet>
+
+static const QString POLKIT_SERVICE = "org.freedesktop.PolicyKit1";
+static const QString POLKIT_AUTHORITY_PATH = "/org/freedesktop/PolicyKit1/Authority";
+static const QString POLKIT_AUTHORITY_INTERFACE = "org.freedesktop.PolicyKit1.Authority";
+// CheckAuthorizationFlags
+static const uint POLKIT_ALLOW_USER_INTERACTION = 0x1;
+
+QDBusArgument &operator<<(QDBusArgument &argument, const PolkitSubject &subject)
+{
+    argument.beginStructure();
+    argument << subject.kind << subject.details;
+    argument.endStructure();
+
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, PolkitSubject &subject)
+{
+    argument.beginStructure();
+    argument >> subject.kind >> subject.details;
+    argument.endStructure();
+
+    return argument;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const PolkitAuthorizationResult &result)
+{
+    argument.beginStructure();
+    argument << result.authorized << result.challenge << result.details;
+    argument.endStructure();
+
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, PolkitAuthorizationResult &result)
+{
+    argument.beginStructure();
+    argument >> result.authorized >> result.challenge >> result.details;
+    argument.endStructure();
+
+    return argument;
+}
+
+Authorizer::Authorizer(const QDBusConnection &bus, QObject *parent)
+    : QObject(parent)
+    , m_bus(bus)
+    , m_serviceWatcher(
+          new QDBusServiceWatcher({}, bus, QDBusServiceWatcher::WatchForUnregistration, this))
+    , m_cancellationSequence(0)
+{
+    qDBusRegisterMetaType<PolkitSubject>();
+    qDBusRegisterMetaType<PolkitAuthorizationResult>();
+    qDBusRegisterMetaType<QMap<QString, QString>>();
+
+    // 基于 NameOwnerChanged，调用方断开连接后立即丢弃其缓存的授权结果
+    connect(m_serviceWatcher,
+            &QDBusServiceWatcher::serviceUnregistered,
+            this,
+            &Authorizer::onServiceUnregistered);
+}
+
+void Authorizer::checkAuthorization(const QString &actionId,
+                                    const QString &service,
+                                    Callback callback)
+{
+    Key key{ service, actionId };
+
+    auto it = m_cache.find(key);
+    if (it != m_cache.end()) {
+        if (!it->hasExpired()) {
+            callback(true);
+            return;
+        }
+        m_cache.erase(it);
+    }
+
+    auto pending = m_pending.find(key);
+    if (pending != m_pending.end()) {
+        pending->append(std::move(callback));
+        return;
+    }
+    m_pending.insert(key, { std::move(callback) });
+    // 在请求 polkit 之前开始监听，调用方在回复之前断开时也能收到通知
+    m_serviceWatcher->addWatchedService(service);
+
+    auto cancellationId =
+        QString("dum-%1-%2").arg(QCoreApplication::applicationPid()).arg(++m_cancellationSequence);
+    auto msg = QDBusMessage::createMethodCall(POLKIT_SERVICE,
+                                              POLKIT_AUTHORITY_PATH,
+                                              POLKIT_AUTHORITY_INTERFACE,
+                                              "CheckAuthorization");
+    msg << QVariant::fromValue(PolkitSubject{ "system-bus-name", { { "name", service } } });
+    msg << actionId;
+    msg << QVariant::fromValue(QMap<QString, QString>{});
+    msg << POLKIT_ALLOW_USER_INTERACTION;
+    msg << cancellationId;
+
+    auto *watcher =
+        new QDBusPendingCallWatcher(m_bus.asyncCall(msg, DUM_AUTHORIZATION_TIMEOUT), this);
+    connect(watcher,
+            &QDBusPendingCallWatcher::finished,
+            this,
+            [this, key, cancellationId](QDBusPendingCallWatcher *w) {
+                w->deleteLater();
+                QDBusPendingReply<PolkitAuthorizationResult> reply = *w;
+                if (reply.isError()) {
+                    qCWarning(logDaemon) << "checkAuthorization failed:" << reply.error().name()
+                                         << reply.error().message();
+                    // 超时时关闭仍在等待输入的认证对话框
+                    if (reply.error().type() == QDBusError::NoReply) {
+                        cancel(cancellationId);
+                    }
+                    finish(key, false);
+                    return;
+                }
+
+                finish(key, reply.value().authorized);
+            });
+}
+
+void Authorizer::finish(const Key &key, bool authorized)
+{
+    // 调用方在回复之前断开时请求已被取消，结果不再缓存
+    auto it = m_pending.find(key);
+    if (it == m_pending.end()) {
+        return;
+    }
+
+    auto callbacks = std::move(*it);
+    m_pending.erase(it);
+    if (authorized) {
+        m_cache.insert(key, QDeadlineTimer(DUM_AUTHORIZATION_CACHE_TTL));
+    }
+    prune();
+
+    for (const auto &callback : callbacks) {
+        callback(authorized);
+    }
+}
+
+void Authorizer::prune()
+{
+    QSet<QString> services;
+    m_cache.removeIf([&services](QHash<Key, QDeadlineTimer>::iterator it) {
+        if (it->hasExpired()) {
+            services.insert(it.key().first);
+            return true;
+        }
+        return false;
+    });
+    for (auto it = m_cache.cbegin(); it != m_cache.cend(); ++it) {
+        services.remove(it.key().first);
+    }
+    for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it) {
+        services.remove(it.key().first);
+    }
+
+    for (const auto &service : std::as_const(services)) {
+        m_serviceWatcher->removeWatchedService(service);
+    }
+}
+
+void Authorizer::cancel(const QString &cancellationId)
+{
+    auto msg = QDBusMessage::createMethodCall(POLKIT_SERVICE,
+                                              POLKIT_AUTHORITY_PATH,
+                                              POLKIT_AUTHORITY_INTERFACE,
+                                              "CancelCheckAuthorization");
+    msg << cancellationId;
+    m_bus.send(msg);
+}
+
+void Authorizer::onServiceUnregistered(const QString &service)
+{
+    m_serviceWatcher->removeWatchedService(service);
+    m_cache.removeIf([&service](QHash<Key, QDeadlineTimer>::iterator it) {
+        return it.key().first == service;
+    });
+
+    // 进行中的请求视为未授权，polkit 之后的回复被忽略
+    QList<Callback> callbacks;
+    m_pending.removeIf([&service, &callbacks](QHash<Key, QList<Callback>>::iterator it) {
+        if (it.key().first != service) {
+            return false;
+        }
+        callbacks.append(std::move(it.value()));
+        return true;
+    });
+    for (const auto &callback : std::as_const(callbacks)) {
+        callback(false);
+    }
+}
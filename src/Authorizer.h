@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusServiceWatcher>
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+
+#include <functional>
+
+// 授权通过的结果在该时间内直接复用，不再请求 polkit
+#define DUM_AUTHORIZATION_CACHE_TTL 15000
+// 等待 polkit 回复的最长时间（毫秒），包括在认证对话框中输入密码的时间。超时后取消认证
+#define DUM_AUTHORIZATION_TIMEOUT 120000
+
+// org.freedesktop.PolicyKit1.Authority 的 Subject (sa{sv})
+struct PolkitSubject
+{
+    QString kind;
+    QVariantMap details;
+};
+Q_DECLARE_METATYPE(PolkitSubject)
+
+// CheckAuthorization 的结果 (bba{ss})
+struct PolkitAuthorizationResult
+{
+    bool authorized = false;
+    bool challenge = false;
+    QMap<QString, QString> details;
+};
+Q_DECLARE_METATYPE(PolkitAuthorizationResult)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const PolkitSubject &subject);
+const QDBusArgument &operator>>(const QDBusArgument &argument, PolkitSubject &subject);
+QDBusArgument &operator<<(QDBusArgument &argument, const PolkitAuthorizationResult &result);
+const QDBusArgument &operator>>(const QDBusArgument &argument, PolkitAuthorizationResult &result);
+
+// 通过 D-Bus 直接调用 polkit 的 CheckAuthorization。
+// 每个请求单独等待回复并有超时，等待管理员认证的请求不会阻塞其它调用方的授权
+class Authorizer : public QObject
+{
+    Q_OBJECT
+public:
+    using Callback = std::function<void(bool authorized)>;
+
+    explicit Authorizer(const QDBusConnection &bus, QObject *parent = nullptr);
+
+    // 异步检查 service 是否拥有 actionId 的授权，结果通过 callback 返回
+    void checkAuthorization(const QString &actionId, const QString &service, Callback callback);
+
+private slots:
+    void onServiceUnregistered(const QString &service);
+
+private:
+    using Key = QPair<QString, QString>; // (service, actionId)
+
+    void finish(const Key &key, bool authorized);
+    void cancel(const QString &cancellationId);
+    // 删除过期的授权结果，不再有缓存和进行中请求的调用方不再监听
+    void prune();
+
+    QDBusConnection m_bus;
+    QDBusServiceWatcher *m_serviceWatcher;
+    QHash<Key, QDeadlineTimer> m_cache;
+    // 进行中的请求，相同调用方和 action 的请求合并为一次 polkit 查询
+    QHash<Key, QList<Callback>> m_pending;
+    quint64 m_cancellationSequence;
+};
@@ -4,60 +4,94 @@
 
 #include "Branch.h"
 
-#include <QList>
-#include <QVersionNumber>
+#include <limits>
 
-Branch::Branch(const QString &str)
+// ref 最多使用的字段数：codename/period/version/project/component/revision
+static const int BRANCH_MAX_FIELDS = 6;
+
+Branch::Branch(QByteArrayView str)
 {
-    auto tmp = str.split('/');
-    if (tmp.size() < 4) {
+    if (str.size() > std::numeric_limits<quint16>::max()) {
+        return;
+    }
+
+    Field fields[BRANCH_MAX_FIELDS];
+    int count = 0;
+    qsizetype offset = 0;
+    while (count < BRANCH_MAX_FIELDS) {
+        auto slashIdx = str.indexOf('/', offset);
+        auto end = slashIdx == -1 ? str.size() : slashIdx;
+        fields[count++] = { quint16(offset), quint16(end - offset) };
+        if (slashIdx == -1) {
+            break;
+        }
+        offset = slashIdx + 1;
+    }
+
+    if (count < 4) {
         // throw std::invalid_argument("Branch format error");
         return;
     }
 
-    m_codeName = tmp[0];
-    m_period = tmp[1];
-    m_version = tmp[2];
+    m_data = str.toByteArray();
+    m_codeName = fields[0];
+    m_period = fields[1];
+    m_version = fields[2];
 
-    if (tmp[3] == COMPONENT_BASE || tmp[3] == COMPONENT_SECURITY) {
-        m_component = tmp[3];
+    auto fourth = field(fields[3]);
+    if (fourth == COMPONENT_BASE || fourth == COMPONENT_SECURITY) {
+        m_component = fields[3];
 
-        if (tmp.size() > 4) {
-            m_revision = tmp[4];
+        if (count > 4) {
+            m_revision = fields[4];
         }
-    } else { // 商业项目
-        m_project = tmp[3];
-        m_component = tmp[4];
+    } else if (count > 4) { // 商业项目
+        m_project = fields[3];
+        m_component = fields[4];
 
-        if (tmp.size() > 5) {
-            m_revision = tmp[5];
+        if (count > 5) {
+            m_revision = fields[5];
         }
     }
+
+    m_versionNumber = QVersionNumber::fromString(QLatin1String(version().data(), version().size()));
+    if (!revision().isEmpty()) {
+        bool ok = false;
+        m_revisionNumber = revision().toLongLong(&ok);
+        if (!ok || m_revisionNumber < 0) {
+            m_revisionNumber = -1;
+        }
+    }
+}
+
+Branch::Branch(const QString &str)
+    : Branch(QByteArrayView(str.toUtf8()))
+{
 }
 
 bool Branch::valid() const
 {
-    if (m_codeName.isEmpty()) {
+    if (codeName().isEmpty()) {
         return false;
     }
 
     // period 只能是 develop 或 release
-    if (m_period != PERIOD_DEVELOP && m_period != PERIOD_RELEASE) {
+    if (period() != PERIOD_DEVELOP && period() != PERIOD_RELEASE) {
         return false;
     }
 
     // component 只能是 base 或 security
-    if (m_component != COMPONENT_BASE && m_component != COMPONENT_SECURITY) {
+    if (component() != COMPONENT_BASE && component() != COMPONENT_SECURITY) {
         return false;
     }
 
     // 非商业项目 base 不能有 revision
-    if (m_project.isEmpty() && m_component == COMPONENT_BASE && !m_revision.isEmpty()) {
+    if (project().isEmpty() && component() == COMPONENT_BASE && !revision().isEmpty()) {
         return false;
     }
 
     // security 不能没有 revision
-    if (m_component == COMPONENT_SECURITY && m_revision.isEmpty()) {
+    if (component() == COMPONENT_SECURITY && revision().isEmpty()) {
         return false;
     }
 
@@ -70,38 +104,50 @@ bool Branch::canUpgradeTo(const Branch &dest) const
         return false;
     }
 
-    if (dest.m_project != m_project) {
+    if (dest.project() != project()) {
         // 非同商业项目
         return false;
     }
 
-    auto version = QVersionNumber::fromString(m_version);
-    auto destVersion = QVersionNumber::fromString(dest.m_version);
-    if (destVersion > version) {
-        return true;
+    return dest.compareVersion(*this) > 0;
+}
+
+int Branch::compareVersion(const Branch &other) const
+{
+    int res = QVersionNumber::compare(m_versionNumber, other.m_versionNumber);
+    if (res != 0) {
+        return res;
     }
 
-    if (dest.m_revision > m_revision) {
-        return true;
+    // 按 (是否为数字, 数值, 原始字节) 比较，保证是严格弱序，可以用于排序和二分查找。
+    // 数字与非数字混合比较时不能分别按数值和字符串比较，否则不满足传递性
+    bool numeric = m_revisionNumber >= 0;
+    bool otherNumeric = other.m_revisionNumber >= 0;
+    if (numeric != otherNumeric) {
+        return numeric ? 1 : -1;
+    }
+    if (numeric && m_revisionNumber != other.m_revisionNumber) {
+        return m_revisionNumber < other.m_revisionNumber ? -1 : 1;
     }
 
-    return false;
+    return revision().compare(other.revision());
 }
 
 QString Branch::toString() const
 {
-    QString str;
-    str += m_codeName + "/" + m_period + "/" + m_version;
+    QByteArray str;
+    str.reserve(m_data.size());
+    str.append(codeName()).append('/').append(period()).append('/').append(version());
 
-    if (!m_project.isEmpty()) {
-        str += "/" + m_project;
+    if (!project().isEmpty()) {
+        str.append('/').append(project());
     }
 
-    str += "/" + m_component;
+    str.append('/').append(component());
 
-    if (!m_revision.isEmpty()) {
-        str += "/" + m_revision;
+    if (!revision().isEmpty()) {
+        str.append('/').append(revision());
     }
 
-    return str;
+    return QString::fromUtf8(str);
 }
@@ -4,35 +4,70 @@
 
 #pragma once
 
+#include <QByteArray>
+#include <QByteArrayView>
 #include <QDBusArgument>
 #include <QString>
+#include <QVersionNumber>
 
-static const QString PERIOD_DEVELOP = "develop";
-static const QString PERIOD_RELEASE = "release";
+static const QByteArrayView PERIOD_DEVELOP = "develop";
+static const QByteArrayView PERIOD_RELEASE = "release";
 
-static const QString COMPONENT_BASE = "base";
-static const QString COMPONENT_SECURITY = "security";
+static const QByteArrayView COMPONENT_BASE = "base";
+static const QByteArrayView COMPONENT_SECURITY = "security";
 
 class Branch
 {
 public:
     Branch() = default;
+    // 直接从 UTF-8 的 ref 解析，各字段只记录在 m_data 中的位置，不单独分配内存
+    explicit Branch(QByteArrayView str);
     explicit Branch(const QString &str);
 
-    const QString &period() const { return m_period; }
+    QByteArrayView codeName() const { return field(m_codeName); }
 
-    const QString &version() const { return m_version; }
+    QByteArrayView period() const { return field(m_period); }
+
+    QByteArrayView version() const { return field(m_version); }
+
+    QByteArrayView project() const { return field(m_project); }
+
+    QByteArrayView component() const { return field(m_component); }
+
+    QByteArrayView revision() const { return field(m_revision); }
 
     bool valid() const;
     bool canUpgradeTo(const Branch &dest) const;
 
+    // 按 version 和 revision 比较新旧，version 按数字逐段比较。revision 为数字的比不是数字的新，
+    // 都是数字时按数值比较，其余情况按字节比较。
+    // 返回值小于、等于、大于 0 分别表示比 other 旧、相同、新
+    int compareVersion(const Branch &other) const;
+
     QString toString() const;
 
 private:
-    QString m_codeName;
-    QString m_period;
-    QString m_version;
-    QString m_project;
-    QString m_component;
-    QString m_revision;
+    struct Field
+    {
+        quint16 offset = 0;
+        quint16 length = 0;
+    };
+
+    QByteArrayView field(Field f) const
+    {
+        return QByteArrayView(m_data).sliced(f.offset, f.length);
+    }
+
+    QByteArray m_data;
+    Field m_codeName;
+    Field m_period;
+    Field m_version;
+    Field m_project;
+    Field m_component;
+    Field m_revision;
+
+    // 构造时预先计算的排序键
+    QVersionNumber m_versionNumber;
+    // revision 不是纯数字时为 -1，为空时为 0
+    qint64 m_revisionNumber = 0;
 };
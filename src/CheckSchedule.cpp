@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "CheckSchedule.h"
+
+qint64 CheckSchedule::backoff(const CheckSchedulePolicy &policy, quint32 failures)
+{
+    qint64 backoff = policy.backoffBase;
+    for (quint32 i = 1; i < failures && backoff < policy.backoffMax; i++) {
+        backoff *= 2;
+    }
+
+    return qMin(backoff, policy.backoffMax);
+}
+
+QVariantMap CheckSchedule::decide(const CheckSchedulePolicy &policy,
+                                  const CheckHistory &history,
+                                  bool upgrading,
+                                  qint64 now)
+{
+    if (upgrading) {
+        return { { "skipped", "upgrading" } };
+    }
+
+    if (history.lastCheckTime > 0 && now >= history.lastCheckTime
+        && now - history.lastCheckTime < policy.interval) {
+        return { { "skipped", "fresh" }, { "lastCheckTime", history.lastCheckTime } };
+    }
+
+    if (history.failures > 0 && now >= history.lastFailure) {
+        auto retryAt = history.lastFailure + backoff(policy, history.failures);
+        if (now < retryAt) {
+            return { { "skipped", "backoff" },
+                     { "failures", history.failures },
+                     { "retryAt", retryAt } };
+        }
+    }
+
+    return {};
+}
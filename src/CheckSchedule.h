@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QVariantMap>
+
+// 定时检查的间隔和退避，时间均为毫秒
+struct CheckSchedulePolicy
+{
+    qint64 interval;
+    qint64 backoffBase;
+    qint64 backoffMax;
+};
+
+// 上次成功和失败的检查，时间为自 1970 年起的毫秒数，0 表示没有
+struct CheckHistory
+{
+    qint64 lastCheckTime;
+    quint32 failures;
+    qint64 lastFailure;
+};
+
+// dum-check.timer 触发时是否检查。只依赖参数，不读取配置和时钟
+class CheckSchedule
+{
+public:
+    // 连续失败 failures 次后的退避时间
+    static qint64 backoff(const CheckSchedulePolicy &policy, quint32 failures);
+    // 需要检查时返回空；否则返回 skipped（fresh、backoff 或 upgrading）以及相关的时间。
+    // 时钟回拨时不跳过，避免长时间不检查
+    static QVariantMap decide(const CheckSchedulePolicy &policy,
+                              const CheckHistory &history,
+                              bool upgrading,
+                              qint64 now);
+};
@@ -0,0 +1,67 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "Config.h"
+
+#include "Log.h"
+#include "ResourceProfile.h"
+
+#include <QSettings>
+
+const Config &Config::instance()
+{
+    static const Config config;
+    return config;
+}
+
+Config::Config()
+{
+    QSettings settings(DUM_CONFIG_FILE, QSettings::IniFormat);
+
+    m_checkFreshness = qMax(0, settings.value("Check/FreshnessSec", 60).toInt()) * 1000;
+    m_checkBackend = settings.value("Check/Backend", DUM_CHECK_BACKEND_UNIT).toString();
+    if (m_checkBackend != DUM_CHECK_BACKEND_UNIT && m_checkBackend != DUM_CHECK_BACKEND_OSTREE) {
+        qCWarning(logDaemon) << "Unknown check backend:" << m_checkBackend;
+        m_checkBackend = DUM_CHECK_BACKEND_UNIT;
+    }
+#ifndef DUM_WITH_OSTREE
+    if (m_checkBackend == DUM_CHECK_BACKEND_OSTREE) {
+        qCWarning(logDaemon) << "Built without libostree, use the unit check backend";
+        m_checkBackend = DUM_CHECK_BACKEND_UNIT;
+    }
+#endif
+    for (const auto &remote : settings.value("Check/Remotes", "default").toStringList()) {
+        auto name = remote.trimmed().toUtf8();
+        if (!name.isEmpty() && !m_checkRemotes.contains(name)) {
+            m_checkRemotes.append(name);
+        }
+    }
+    if (m_checkRemotes.isEmpty()) {
+        m_checkRemotes.append("default");
+    }
+    m_checkRemoteTimeout =
+        qMax(1, settings.value("Check/RemoteTimeoutSec", 30).toInt()) * 1000;
+    m_prefetch = settings.value("Prefetch/Enabled", false).toBool();
+    m_resourceProfile =
+        settings.value("Upgrade/ResourceProfile", DUM_RESOURCE_PROFILE_FOREGROUND).toString();
+    if (!ResourceProfile::isValid(m_resourceProfile)) {
+        qCWarning(logDaemon) << "Unknown resource profile:" << m_resourceProfile;
+        m_resourceProfile = DUM_RESOURCE_PROFILE_FOREGROUND;
+    }
+    m_backgroundMemoryHigh =
+        qMax(64ULL, settings.value("Upgrade/BackgroundMemoryHighMB", 2048ULL).toULongLong())
+        * 1024 * 1024;
+    m_idleMinTimeout = qMax(1, settings.value("Idle/MinTimeoutSec", 10).toInt()) * 1000;
+    m_idleMaxTimeout =
+        qMax(m_idleMinTimeout / 1000, settings.value("Idle/MaxTimeoutSec", 600).toInt()) * 1000;
+    m_scheduleInterval =
+        qMax(60LL, settings.value("Schedule/IntervalSec", 86400LL).toLongLong()) * 1000;
+    m_scheduleBackoffBase =
+        qMax(1LL, settings.value("Schedule/BackoffBaseSec", 600LL).toLongLong()) * 1000;
+    m_scheduleBackoffMax = qMax(m_scheduleBackoffBase / 1000,
+                                settings.value("Schedule/BackoffMaxSec", 86400LL).toLongLong())
+        * 1000;
+    m_progressMaxRate = qMax(0.0, settings.value("Progress/MaxRate", 5.0).toDouble());
+    m_progressMinDelta = qMax(0.0, settings.value("Progress/MinDelta", 1.0).toDouble());
+}
@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArrayList>
+#include <QString>
+
+#define DUM_CONFIG_FILE "/etc/deepin-update-manager/config.ini"
+
+// 通过 dum-list-remote-refs.service 列出远程分支
+#define DUM_CHECK_BACKEND_UNIT "unit"
+// 通过 libostree 在进程内列出远程分支，需要以 DUM_WITH_OSTREE 构建
+#define DUM_CHECK_BACKEND_OSTREE "ostree"
+
+// 启动时从 DUM_CONFIG_FILE 读取的配置，未配置的项使用默认值
+class Config
+{
+public:
+    static const Config &instance();
+
+    // checkUpgrade 结果的有效期（毫秒），有效期内的检查直接返回上次的结果，0 表示不缓存
+    int checkFreshness() const { return m_checkFreshness; }
+
+    // 列出远程分支的方式，DUM_CHECK_BACKEND_UNIT 或 DUM_CHECK_BACKEND_OSTREE
+    const QString &checkBackend() const { return m_checkBackend; }
+
+    // 检查的远程仓库，按优先级排列，版本相同时选择靠前的仓库
+    const QByteArrayList &checkRemotes() const { return m_checkRemotes; }
+
+    // 单个远程仓库检查的超时时间（毫秒）。只用于 ostree 后端，unit 后端的所有仓库共用一次运行
+    int checkRemoteTimeout() const { return m_checkRemoteTimeout; }
+
+    // 检查到可升级的分支后，是否在后台以低优先级预先拉取升级内容
+    bool prefetch() const { return m_prefetch; }
+
+    // 升级默认使用的资源配置，DUM_RESOURCE_PROFILE_BACKGROUND 或 DUM_RESOURCE_PROFILE_FOREGROUND
+    const QString &resourceProfile() const { return m_resourceProfile; }
+
+    // background 资源配置下升级 unit 的内存高水位（字节）
+    qulonglong backgroundMemoryHigh() const { return m_backgroundMemoryHigh; }
+
+    // 自适应空闲退出的超时时间范围（毫秒）
+    int idleMinTimeout() const { return m_idleMinTimeout; }
+
+    int idleMaxTimeout() const { return m_idleMaxTimeout; }
+
+    // 定时检查的间隔（毫秒），距上次成功检查不足该间隔时跳过
+    qint64 scheduleInterval() const { return m_scheduleInterval; }
+
+    // 检查失败后定时检查的退避时间（毫秒），每次连续失败翻倍，不超过 scheduleBackoffMax
+    qint64 scheduleBackoffBase() const { return m_scheduleBackoffBase; }
+
+    qint64 scheduleBackoffMax() const { return m_scheduleBackoffMax; }
+
+    // progress 信号每秒最多发送的次数，0 表示不限制
+    double progressMaxRate() const { return m_progressMaxRate; }
+
+    // 同一阶段内进度变化小于该百分比时不发送 progress 信号
+    double progressMinDelta() const { return m_progressMinDelta; }
+
+private:
+    Config();
+
+    int m_checkFreshness;
+    QString m_checkBackend;
+    QByteArrayList m_checkRemotes;
+    int m_checkRemoteTimeout;
+    bool m_prefetch;
+    QString m_resourceProfile;
+    qulonglong m_backgroundMemoryHigh;
+    int m_idleMinTimeout;
+    int m_idleMaxTimeout;
+    qint64 m_scheduleInterval;
+    qint64 m_scheduleBackoffBase;
+    qint64 m_scheduleBackoffMax;
+    double m_progressMaxRate;
+    double m_progressMinDelta;
+};
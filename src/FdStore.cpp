@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "FdStore.h"
+
+#include "Log.h"
+
+#include <systemd/sd-daemon.h>
+
+#include <string.h>
+
+bool FdStore::store(int fd, const QString &name)
+{
+    auto state = QString("FDSTORE=1\nFDNAME=%1\nFDPOLL=0").arg(name).toUtf8();
+    int ret = sd_pid_notify_with_fds(0, 0, state.constData(), &fd, 1);
+    if (ret < 0) {
+        qCWarning(logDaemon) << "Store fd" << name << "failed:" << strerror(-ret);
+    }
+
+    // 返回 0 表示不是由 systemd 启动的
+    return ret > 0;
+}
+
+void FdStore::remove(const QString &name)
+{
+    auto state = QString("FDSTOREREMOVE=1\nFDNAME=%1").arg(name).toUtf8();
+    int ret = sd_notify(0, state.constData());
+    if (ret < 0) {
+        qCWarning(logDaemon) << "Remove fd" << name << "failed:" << strerror(-ret);
+    }
+}
@@ -0,0 +1,21 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QString>
+
+// 存入 systemd fd store 的文件描述符名称，重启后通过 sd_listen_fds_with_names 取回
+#define DUM_FDNAME_UPGRADE_CONNECTION "dum-upgrade-connection"
+#define DUM_FDNAME_UPGRADE_SNAPSHOT "dum-upgrade-snapshot"
+
+// systemd 的 fd store，需要服务配置 FileDescriptorStoreMax 和 NotifyAccess
+class FdStore
+{
+public:
+    // 存入 fd 的副本，systemd 不会因 POLLHUP 自动移除，需要调用 remove
+    static bool store(int fd, const QString &name);
+    // 移除所有名为 name 的 fd
+    static void remove(const QString &name);
+};
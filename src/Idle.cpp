@@ -4,14 +4,24 @@
 
 #include "Idle.h"
 
+#include "Config.h"
+#include "Log.h"
+
 #include <QCoreApplication>
+#include <QDateTime>
+
+// 请求间隔的平滑系数
+static const double INTER_ARRIVAL_ALPHA = 0.3;
 
 Idle::Idle(QObject *parent)
     : QObject(parent)
+    , m_minTimeout(Config::instance().idleMinTimeout())
+    , m_maxTimeout(Config::instance().idleMaxTimeout())
+    , m_timeout(qBound(m_minTimeout, DUM_AUTO_IDLE_TIMEOUT, m_maxTimeout))
 {
     m_timer = new QTimer(this);
     connect(m_timer,  &QTimer::timeout, this, &Idle::onTimeout);
-    m_timer->start(DUM_AUTO_IDLE_TIMEOUT);
+    m_timer->start(m_timeout);
 }
 
 void Idle::onTimeout() const
@@ -33,17 +43,69 @@ void Idle::UnInhibit(const QString& task)
     handleInhibit();
 }
 
+void Idle::Restore(quint32 restartCount, qint64 interArrival, qint64 lastRequest)
+{
+    m_restartCount = restartCount;
+    m_interArrival = interArrival;
+    m_lastRequest = lastRequest;
+    updateTimeout();
+}
+
+void Idle::SetColdStartCost(qint64 cost)
+{
+    m_coldStartCost = cost;
+    qCInfo(logDaemon) << "dum cold start took" << cost << "ms";
+    updateTimeout();
+}
+
+void Idle::RecordRequest()
+{
+    auto now = QDateTime::currentMSecsSinceEpoch();
+    if (m_lastRequest > 0 && now > m_lastRequest) {
+        auto gap = now - m_lastRequest;
+        m_interArrival = m_interArrival > 0
+            ? qint64(INTER_ARRIVAL_ALPHA * gap + (1 - INTER_ARRIVAL_ALPHA) * m_interArrival)
+            : gap;
+    }
+    m_lastRequest = now;
+
+    updateTimeout();
+    // 空闲计时从最后一次请求开始
+    if (m_timer->isActive()) {
+        m_timer->start(m_timeout);
+    }
+}
+
+void Idle::updateTimeout()
+{
+    // 请求间隔在上限之内时保持到下一次请求之后，否则尽快退出
+    qint64 timeout = DUM_AUTO_IDLE_TIMEOUT;
+    if (m_interArrival > 0) {
+        timeout = m_interArrival <= m_maxTimeout ? 2 * m_interArrival : m_minTimeout;
+    }
+    timeout = qMax(timeout, m_coldStartCost * DUM_IDLE_COLD_START_FACTOR);
+
+    int bounded = int(qBound<qint64>(m_minTimeout, timeout, m_maxTimeout));
+    if (bounded != m_timeout) {
+        m_timeout = bounded;
+        if (m_timer->isActive()) {
+            m_timer->start(m_timeout);
+        }
+        Q_EMIT timeoutChanged(m_timeout);
+    }
+}
+
 void Idle::handleInhibit() const
 {
     if (m_reasons.isEmpty()) {
         if (!m_timer->isActive()) {
-            m_timer->start(DUM_AUTO_IDLE_TIMEOUT);
-            qInfo() << "dum idle on, will be exiting in 60s";
+            m_timer->start(m_timeout);
+            qCInfo(logDaemon) << "dum idle on, will be exiting in" << m_timeout / 1000 << "s";
         }
     } else {
         if (m_timer->isActive()) {
             m_timer->stop();
         }
-        qInfo() << "dum inhibited, tasks on handling:" << m_reasons;
+        qCInfo(logDaemon) << "dum inhibited, tasks on handling:" << m_reasons;
     }
 }
@@ -8,8 +8,13 @@
 #include <QTimer>
 #include <QObject>
 
+// 没有请求间隔的记录时使用的超时时间
 #define DUM_AUTO_IDLE_TIMEOUT 60000
+// 超时时间至少为冷启动耗时的倍数，冷启动越慢越倾向于保持运行
+#define DUM_IDLE_COLD_START_FACTOR 100
 
+// 没有进行中的任务时空闲退出。
+// 超时时间根据请求间隔自适应：请求频繁时保持运行，避免反复退出和重新激活；请求稀疏时尽快退出
 class Idle: public QObject
 {
     Q_OBJECT
@@ -18,8 +23,24 @@ public:
     void Inhibit(const QString& task);
     void UnInhibit(const QString& task);
 
+    // 恢复上次运行时的统计，lastRequest 为上次请求的时间（自 1970 年起的毫秒数）
+    void Restore(quint32 restartCount, qint64 interArrival, qint64 lastRequest);
+    void SetColdStartCost(qint64 cost);
+    // 每个 D-Bus 请求到达时调用
+    void RecordRequest();
+
+    quint32 restartCount() const { return m_restartCount; }
+    qint64 coldStartCost() const { return m_coldStartCost; }
+    qint64 interArrival() const { return m_interArrival; }
+    qint64 lastRequest() const { return m_lastRequest; }
+    int timeout() const { return m_timeout; }
+
+Q_SIGNALS:
+    void timeoutChanged(int timeout);
+
 private:
     void handleInhibit() const;
+    void updateTimeout();
 
 public Q_SLOTS:
     void onTimeout() const;
@@ -27,6 +48,14 @@ public Q_SLOTS:
 private:
     QTimer *m_timer{};
     QStringList m_reasons;
+    int m_minTimeout;
+    int m_maxTimeout;
+    int m_timeout;
+    quint32 m_restartCount{};
+    qint64 m_coldStartCost{};
+    // 请求间隔的指数加权平均值（毫秒）
+    qint64 m_interArrival{};
+    qint64 m_lastRequest{};
 };
 
 
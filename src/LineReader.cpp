@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "LineReader.h"
+
+#include "Log.h"
+
+#include <cstring>
+
+LineReader::LineReader(qsizetype capacity)
+    : m_capacity(capacity)
+    , m_buffer(new char[capacity])
+    , m_scratch(new char[capacity])
+    , m_head(0)
+    , m_size(0)
+    , m_discarding(false)
+    , m_overlongLines(0)
+{
+}
+
+void LineReader::readFrom(QIODevice *device, const LineHandler &handler)
+{
+    while (true) {
+        if (m_size == m_capacity) {
+            // 缓冲区已满且其中没有换行，丢弃这一行直到下一个换行
+            m_overlongLines++;
+            // 调用方按 overlongLines 输出汇总
+            qCDebug(logIo) << "Line longer than" << m_capacity << "bytes, dropped";
+            m_head = 0;
+            m_size = 0;
+            m_discarding = true;
+        }
+
+        auto tail = (m_head + m_size) % m_capacity;
+        auto contiguous = qMin(m_capacity - m_size, m_capacity - tail);
+        auto size = device->read(m_buffer.get() + tail, contiguous);
+        if (size <= 0) {
+            return;
+        }
+
+        m_size += size;
+        scan(tail, size, handler);
+    }
+}
+
+void LineReader::finish(const LineHandler &handler)
+{
+    if (!m_discarding && m_size > 0) {
+        emitLine(m_size, handler);
+    }
+    reset();
+}
+
+void LineReader::reset()
+{
+    m_head = 0;
+    m_size = 0;
+    m_discarding = false;
+}
+
+void LineReader::scan(qsizetype offset, qsizetype size, const LineHandler &handler)
+{
+    const char *chunk = m_buffer.get() + offset;
+    while (size > 0) {
+        auto *newline = static_cast<const char *>(std::memchr(chunk, '\n', size));
+        if (!newline) {
+            break;
+        }
+
+        auto pos = newline - m_buffer.get();
+        auto length = (pos - m_head + m_capacity) % m_capacity;
+        if (m_discarding) {
+            m_discarding = false;
+            m_head = (m_head + length + 1) % m_capacity;
+            m_size -= length + 1;
+        } else {
+            emitLine(length, handler);
+            m_head = (m_head + 1) % m_capacity;
+            m_size -= 1;
+        }
+
+        size -= newline + 1 - chunk;
+        chunk = newline + 1;
+    }
+
+    if (m_discarding) {
+        m_head = (m_head + m_size) % m_capacity;
+        m_size = 0;
+    }
+}
+
+void LineReader::emitLine(qsizetype length, const LineHandler &handler)
+{
+    if (m_head + length <= m_capacity) {
+        handler(QByteArrayView(m_buffer.get() + m_head, length));
+    } else {
+        auto first = m_capacity - m_head;
+        std::memcpy(m_scratch.get(), m_buffer.get() + m_head, first);
+        std::memcpy(m_scratch.get() + first, m_buffer.get(), length - first);
+        handler(QByteArrayView(m_scratch.get(), length));
+    }
+
+    m_head = (m_head + length) % m_capacity;
+    m_size -= length;
+}
@@ -0,0 +1,45 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArrayView>
+#include <QIODevice>
+
+#include <functional>
+#include <memory>
+
+// 基于固定容量环形缓冲区的按行读取器。
+// 每次可读时整块读取，用 memchr 查找换行，完整的行以视图的形式交给调用方，不做拷贝
+// （跨越缓冲区末尾的行除外）。超过容量仍没有换行的行会被丢弃并计数，内存占用不会增长。
+class LineReader
+{
+public:
+    using LineHandler = std::function<void(QByteArrayView line)>;
+
+    explicit LineReader(qsizetype capacity);
+
+    // 读取 device 当前所有可读的数据，line 不包含换行符，仅在 handler 调用期间有效
+    void readFrom(QIODevice *device, const LineHandler &handler);
+    // 数据结束，把最后不以换行结尾的数据作为一行交给 handler
+    void finish(const LineHandler &handler);
+    void reset();
+
+    qsizetype capacity() const { return m_capacity; }
+
+    quint64 overlongLines() const { return m_overlongLines; }
+
+private:
+    void scan(qsizetype offset, qsizetype size, const LineHandler &handler);
+    void emitLine(qsizetype length, const LineHandler &handler);
+
+    qsizetype m_capacity;
+    std::unique_ptr<char[]> m_buffer;
+    // 跨越缓冲区末尾的行拷贝到这里再交给调用方
+    std::unique_ptr<char[]> m_scratch;
+    qsizetype m_head;
+    qsizetype m_size;
+    bool m_discarding;
+    quint64 m_overlongLines;
+};
@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "Log.h"
+
+#include <systemd/sd-journal.h>
+
+#include <QMap>
+
+#include <utility>
+#include <vector>
+
+Q_LOGGING_CATEGORY(logCheck, DUM_LOG_CATEGORY_PREFIX "check", QtInfoMsg)
+Q_LOGGING_CATEGORY(logRefs, DUM_LOG_CATEGORY_PREFIX "refs", QtInfoMsg)
+Q_LOGGING_CATEGORY(logUpgrade, DUM_LOG_CATEGORY_PREFIX "upgrade", QtInfoMsg)
+Q_LOGGING_CATEGORY(logIo, DUM_LOG_CATEGORY_PREFIX "io", QtInfoMsg)
+Q_LOGGING_CATEGORY(logDaemon, DUM_LOG_CATEGORY_PREFIX "daemon", QtInfoMsg)
+
+// 按从低到高的顺序
+static const QStringList LOG_LEVELS = { "debug", "info", "warning", "critical" };
+
+// 通过 setLevel 设置的级别，键为去掉前缀的分类名称，* 排在最前面
+static QMap<QString, QString> s_levels;
+
+QStringList Log::categories()
+{
+    return { "check", "refs", "upgrade", "io", "daemon" };
+}
+
+bool Log::setLevel(const QString &category, const QString &level)
+{
+    if (!LOG_LEVELS.contains(level)) {
+        return false;
+    }
+    if (category == "*") {
+        // 对所有分类生效，覆盖之前单独设置的级别
+        s_levels.clear();
+    } else if (!categories().contains(category)) {
+        return false;
+    }
+    s_levels.insert(category, level);
+
+    // 规则按顺序应用，后面的覆盖前面的
+    QStringList rules;
+    for (auto it = s_levels.cbegin(); it != s_levels.cend(); ++it) {
+        auto enabledFrom = LOG_LEVELS.indexOf(it.value());
+        for (int i = 0; i < LOG_LEVELS.size(); i++) {
+            rules.append(QString("%1%2.%3=%4")
+                             .arg(DUM_LOG_CATEGORY_PREFIX,
+                                  it.key(),
+                                  LOG_LEVELS[i],
+                                  i >= enabledFrom ? "true" : "false"));
+        }
+    }
+    QLoggingCategory::setFilterRules(rules.join('\n'));
+
+    return true;
+}
+
+void Log::event(int priority,
+                const QByteArray &event,
+                const QString &message,
+                const Fields &fields)
+{
+    QByteArrayList entries = {
+        "MESSAGE=" + message.toUtf8(),
+        "PRIORITY=" + QByteArray::number(priority),
+        "DUM_EVENT=" + event,
+    };
+    for (const auto &field : fields) {
+        entries.append("DUM_" + field.first + "=" + field.second);
+    }
+
+    std::vector<iovec> iov;
+    iov.reserve(entries.size());
+    for (const auto &entry : std::as_const(entries)) {
+        iov.push_back({ const_cast<char *>(entry.constData()), size_t(entry.size()) });
+    }
+    sd_journal_sendv(iov.data(), iov.size());
+}
+
+LogRateLimit::LogRateLimit(int burst, qint64 interval)
+    : m_burst(burst)
+    , m_interval(interval)
+    , m_count(0)
+    , m_suppressed(0)
+{
+}
+
+bool LogRateLimit::allow(quint64 *suppressed)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_window.isValid() || m_window.hasExpired(m_interval)) {
+        m_window.start();
+        m_count = 0;
+    }
+    if (m_count >= m_burst) {
+        m_suppressed++;
+        return false;
+    }
+
+    m_count++;
+    *suppressed = std::exchange(m_suppressed, 0);
+    return true;
+}
@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QPair>
+#include <QStringList>
+
+#include <syslog.h>
+
+// 日志分类名称的前缀，分类默认只输出 info 及以上级别
+#define DUM_LOG_CATEGORY_PREFIX "org.deepin.dum."
+
+Q_DECLARE_LOGGING_CATEGORY(logCheck)
+Q_DECLARE_LOGGING_CATEGORY(logRefs)
+Q_DECLARE_LOGGING_CATEGORY(logUpgrade)
+Q_DECLARE_LOGGING_CATEGORY(logIo)
+// 状态保存、fd store、授权和空闲退出等守护进程自身的日志
+Q_DECLARE_LOGGING_CATEGORY(logDaemon)
+
+class Log
+{
+public:
+    using Fields = QList<QPair<QByteArray, QByteArray>>;
+
+    // 去掉前缀的分类名称
+    static QStringList categories();
+    // category 为 categories() 中的名称或 *，level 为 debug、info、warning、critical，
+    // 低于 level 的日志不再输出。参数无效时返回 false
+    static bool setLevel(const QString &category, const QString &level);
+
+    // 重要事件直接以结构化字段写入日志：DUM_EVENT 为 event，fields 的字段名会加上 DUM_ 前缀
+    static void event(int priority,
+                      const QByteArray &event,
+                      const QString &message,
+                      const Fields &fields = {});
+};
+
+// 按调用点限制日志的频率，通常声明为函数内的 static 变量。
+// 每个周期内最多输出 burst 条，超出的只计数，下一次允许输出时取回被抑制的条数
+class LogRateLimit
+{
+public:
+    // interval 为毫秒
+    LogRateLimit(int burst, qint64 interval);
+
+    // 返回 true 时输出日志，suppressed 为上次输出以来被抑制的条数
+    bool allow(quint64 *suppressed);
+
+private:
+    QMutex m_mutex;
+    QElapsedTimer m_window;
+    int m_burst;
+    qint64 m_interval;
+    int m_count;
+    quint64 m_suppressed;
+};
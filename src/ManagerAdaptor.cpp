@@ -4,15 +4,35 @@
 
 #include "ManagerAdaptor.h"
 
+#include "Authorizer.h"
 #include "Branch.h"
-
-#include <PolkitQt1/Authority>
+#include "CheckSchedule.h"
+#include "Config.h"
+#include "FdStore.h"
+#include "Log.h"
+#include "MetricsAdaptor.h"
+#include "OutputReader.h"
+#include "ProgressHistory.h"
+#include "ProgressStream.h"
+#include "ResourceProfile.h"
+#ifdef DUM_WITH_OSTREE
+#include "OstreeRefLister.h"
+#endif
+#include "StateStore.h"
+#include "UnitRegistry.h"
 
 #include <QDBusObjectPath>
-#include <QLocalSocket>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDateTime>
+
+#include <utility>
+
+#include <unistd.h>
 
 static const QString SYSTEMD1_SERVICE = "org.freedesktop.systemd1";
 static const QString SYSTEMD1_MANAGER_PATH = "/org/freedesktop/systemd1";
+static const QString SYSTEMD1_MANAGER_INTERFACE = "org.freedesktop.systemd1.Manager";
 
 static const QString STATE_IDEL = "idle";
 static const QString STATE_CHECKING = "checking";
@@ -20,33 +40,32 @@ static const QString STATE_UPGRADING = "upgrading";
 static const QString STATE_FAILED = "failed";
 static const QString STATE_SUCCESS = "success";
 
+static const QString PREFETCH_STATE_NONE = "none";
+static const QString PREFETCH_STATE_PREFETCHING = "prefetching";
+static const QString PREFETCH_STATE_PREFETCHED = "prefetched";
+static const QString PREFETCH_STATE_FAILED = "failed";
+
 static const QString OSTREE_REPO = "/sysroot/ostree/repo";
 static const QByteArray OSTREE_DEFAULT_REMOTE_NAME = "default";
 
 static const QString ACTION_ID_CHECK_UPGRADE = "org.deepin.UpdateManager.check-upgrade";
 static const QString ACTION_ID_UPGRADE = "org.deepin.UpdateManager.upgrade";
+static const QString ACTION_ID_CONFIGURE = "org.deepin.UpdateManager.configure";
 
-static const QString DUM_STATE_FILE = "/tmp/dum-status.ini";
+static const QString DUM_LIST_REMOTE_REFS_UNIT = "dum-list-remote-refs.service";
+// 等待 dum-list-remote-refs.service 连接输出 socket 的超时时间
+static const int LIST_REMOTE_REFS_CONNECT_TIMEOUT = 5000;
+// 上一次检查的 dum-list-remote-refs.service 仍在运行时，等待其结束的超时时间
+static const int LIST_REMOTE_REFS_STOP_TIMEOUT = 5000;
+static const int LIST_UPGRADE_TARGETS_LIMIT = 32;
 
-QDBusArgument &operator<<(QDBusArgument &argument, const Progress &progress)
-{
-    argument.beginStructure();
-    argument << progress.stage << progress.percent;
-    argument.endStructure();
-
-    return argument;
-}
-
-const QDBusArgument &operator>>(const QDBusArgument &argument, Progress &progress)
+static QString systemdEscape(const QString &str)
 {
-    argument.beginStructure();
-    argument >> progress.stage;
-    double d;
-    argument >> d;
-    progress.percent = d;
-    argument.endStructure();
+    auto tmp = str;
+    tmp.replace('-', "\\x2d");
+    tmp.replace('/', "-");
 
-    return argument;
+    return tmp;
 }
 
 ManagerAdaptor::ManagerAdaptor(int listRemoteRefsFd,
@@ -55,194 +74,569 @@ ManagerAdaptor::ManagerAdaptor(int listRemoteRefsFd,
                                QObject *parent)
     : QObject(parent)
     , m_bus(bus)
-    , m_listRemoteRefsStdoutServer(new QLocalServer(this))
-    , m_upgradeStdoutServer(new QLocalServer(this))
+    , m_outputReader(
+          new OutputReader(listRemoteRefsFd, upgradeStdoutFd, Config::instance().checkRemotes()))
     , m_systemdManager(new org::freedesktop::systemd1::Manager(
           SYSTEMD1_SERVICE, SYSTEMD1_MANAGER_PATH, bus, this))
+    , m_unitRegistry(new UnitRegistry(m_systemdManager, bus, this))
     , m_dumUpgradeUnit(nullptr)
+    , m_prefetchState(PREFETCH_STATE_NONE)
+    , m_resourceProfile(Config::instance().resourceProfile())
+    , m_listRemoteRefsConnectTimer(new QTimer(this))
+    , m_check(0)
+    , m_checkSequence(0)
+    , m_listRemoteRefsConnected(false)
     , m_state(STATE_IDEL)
     , m_upgradable(false)
     , m_idle(new Idle)
+    , m_authorizer(new Authorizer(bus, this))
+    , m_progressCoalescer(new ProgressCoalescer(
+          Config::instance().progressMaxRate(), Config::instance().progressMinDelta(), this))
+    , m_stateStore(new StateStore(DUM_STATE_STORE_FILE, this))
+    , m_progressStream(new ProgressStream(this))
+    , m_metrics(new MetricsAdaptor(this))
+    , m_currentProgress{ QString(), 0 }
+    , m_progressSubscriberWatcher(
+          new QDBusServiceWatcher({}, bus, QDBusServiceWatcher::WatchForUnregistration, this))
+    , m_propertiesChangedTimer(new QTimer(this))
+    , m_lastCheckTime(0)
+    , m_checkFailures(0)
+    , m_lastCheckFailure(0)
 {
     qRegisterMetaType<Progress>("Progress");
     qDBusRegisterMetaType<Progress>();
+    ResourceProfile::registerMetaTypes();
+    ProgressHistory::registerMetaTypes();
 
-    m_settings = new QSettings(DUM_STATE_FILE, QSettings::IniFormat);
-    QFile stateFile(DUM_STATE_FILE);
-    if (stateFile.exists()) {
-        // 如果文件存在，则说明是空闲退出且没有重启过。读取settings配置恢复之前的状态
+#ifdef DUM_WITH_OSTREE
+    m_ostreeRefLister = new OstreeRefLister(this);
+#endif
+
+    if (m_stateStore->load()) {
+        // 如果文件存在，则说明是空闲退出且没有重启过。恢复之前的状态
         loadStatus();
     }
-    m_listRemoteRefsStdoutServer->listen(listRemoteRefsFd);
+    // 启动时就保存重启次数，进程崩溃或被 watchdog 重启时也会计入
+    m_stateStore->setIdleStats(m_idle->restartCount(),
+                               m_idle->interArrival(),
+                               m_idle->lastRequest());
+    // 输出的读取和解析在 I/O 线程中进行，结果通过 queued 连接回到当前线程
+    m_outputReader->moveToThread(&m_ioThread);
+    connect(&m_ioThread, &QThread::finished, m_outputReader, &QObject::deleteLater);
+    connect(m_outputReader,
+            &OutputReader::listRemoteRefsConnected,
+            this,
+            &ManagerAdaptor::onListRemoteRefsConnected);
+    connect(m_outputReader,
+            &OutputReader::listRemoteRefsFinished,
+            this,
+            &ManagerAdaptor::finishCheckUpgrade);
+    connect(m_outputReader,
+            &OutputReader::upgradeProgress,
+            this,
+            &ManagerAdaptor::onUpgradeProgress);
+    m_ioThread.setObjectName("dum-io");
+    m_ioThread.start();
+    QMetaObject::invokeMethod(m_outputReader, &OutputReader::start, Qt::QueuedConnection);
 
-    m_upgradeStdoutServer->listen(upgradeStdoutFd);
-    connect(m_upgradeStdoutServer, &QLocalServer::newConnection, this, [this] {
-        auto *socket = m_upgradeStdoutServer->nextPendingConnection();
-        connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
-        connect(socket, &QLocalSocket::readyRead, this, [this, socket] {
-            while (socket->canReadLine()) {
-                auto line = socket->readLine();
-                parseUpgradeStdoutLine(line);
-            }
-        });
+    m_listRemoteRefsConnectTimer->setSingleShot(true);
+    m_listRemoteRefsConnectTimer->setInterval(LIST_REMOTE_REFS_CONNECT_TIMEOUT);
+    connect(m_listRemoteRefsConnectTimer, &QTimer::timeout, this, [this] {
+        failCheckUpgrade(QDBusError::InternalError, "WaitForNewConnection failed");
     });
 
+    connect(m_progressCoalescer,
+            &ProgressCoalescer::progressReady,
+            this,
+            [this](const Progress &progress) {
+                m_upgradeSnapshot.update(progress);
+                emit this->progress(progress);
+            });
+
+    connect(m_unitRegistry,
+            &UnitRegistry::activeStateChanged,
+            this,
+            [this](const QString &unit, const QString &activeState) {
+                if (unit == m_dumUpgradeUnitName) {
+                    onDumUpgradeUnitStateChanged(activeState);
+                }
+            });
+    connect(m_unitRegistry,
+            &UnitRegistry::jobRemoved,
+            this,
+            [this](const QString &unit, const QDBusObjectPath &job, const QString &result) {
+                if (unit == m_prefetchUnitName) {
+                    onPrefetchJobRemoved(job.path(), result);
+                }
+            });
+
+    connect(m_progressSubscriberWatcher,
+            &QDBusServiceWatcher::serviceUnregistered,
+            this,
+            [this](const QString &service) {
+                m_progressSubscriberWatcher->removeWatchedService(service);
+                m_progressStream->dropOwner(service);
+            });
+
+    m_propertiesChangedTimer->setSingleShot(true);
+    m_propertiesChangedTimer->setInterval(0);
+    connect(m_propertiesChangedTimer,
+            &QTimer::timeout,
+            this,
+            &ManagerAdaptor::flushPropertiesChanged);
+
     connect(this, &ManagerAdaptor::stateChanged, this, [this](const QString &state) {
-        m_settings->setValue("state", state);
+        m_stateStore->setState(state);
         sendPropertyChanged("state", state);
     });
     connect(this, &ManagerAdaptor::upgradableChanged, this, [this](bool upgradable) {
-        m_settings->setValue("upgradable", upgradable);
+        m_stateStore->setUpgradable(upgradable);
         sendPropertyChanged("upgradable", upgradable);
     });
+    connect(m_idle, &Idle::timeoutChanged, this, &ManagerAdaptor::idleTimeoutChanged);
+    connect(this, &ManagerAdaptor::idleTimeoutChanged, this, [this](int timeout) {
+        sendPropertyChanged("idleTimeout", timeout);
+    });
+    connect(this, &ManagerAdaptor::coldStartTimeChanged, this, [this](qlonglong coldStartTime) {
+        sendPropertyChanged("coldStartTime", coldStartTime);
+    });
+    connect(this, &ManagerAdaptor::prefetchStateChanged, this, [this](const QString &state) {
+        sendPropertyChanged("prefetchState", state);
+    });
+    connect(this, &ManagerAdaptor::resourceProfileChanged, this, [this](const QString &profile) {
+        m_stateStore->setResourceProfile(profile);
+        sendPropertyChanged("resourceProfile", profile);
+    });
+    connect(this, &ManagerAdaptor::resourceLimitsChanged, this, [this](const QVariantMap &limits) {
+        sendPropertyChanged("resourceLimits", limits);
+    });
 }
 
-ManagerAdaptor::~ManagerAdaptor() = default;
+ManagerAdaptor::~ManagerAdaptor()
+{
+    // 之后的请求间隔只在退出时保存，避免每个请求都写一次文件
+    m_stateStore->setIdleStats(m_idle->restartCount(),
+                               m_idle->interArrival(),
+                               m_idle->lastRequest());
+    m_stateStore->flush();
+
+    m_ioThread.quit();
+    m_ioThread.wait();
+}
 
-void ManagerAdaptor::checkUpgrade(const QDBusMessage &message)
+void ManagerAdaptor::setColdStartCost(qint64 cost)
 {
-    if (!checkAuthorization(ACTION_ID_CHECK_UPGRADE, message.service())) {
-        m_bus.send(message.createErrorReply(QDBusError::AccessDenied, "Not authorized"));
-        return;
+    m_idle->SetColdStartCost(cost);
+    emit coldStartTimeChanged(m_idle->coldStartCost());
+}
+
+void ManagerAdaptor::restoreUpgrade(int connectionFd, int snapshotFd)
+{
+    if (snapshotFd >= 0) {
+        if (m_upgradeSnapshot.restore(snapshotFd)) {
+            auto unit = m_upgradeSnapshot.unit();
+            qCInfo(logUpgrade) << "Restore upgrade of" << unit;
+            m_idle->Inhibit(STATE_UPGRADING);
+            m_unitRegistry->acquire(
+                unit,
+                [this, unit](org::freedesktop::systemd1::Unit *proxy, const QString &error) {
+                    if (!proxy) {
+                        qCWarning(logUpgrade) << "Restore upgrade unit failed:" << error;
+                        abandonRestoredUpgrade();
+                        return;
+                    }
+
+                    m_dumUpgradeUnit = proxy;
+                    m_dumUpgradeUnitName = unit;
+                    // 快照只在升级进行中存在。保存的状态可能已经丢失，先按升级中处理，
+                    // 重启期间升级已经结束时由下面的同步得到结果并解除空闲抑制
+                    if (m_state != STATE_UPGRADING) {
+                        m_state = STATE_UPGRADING;
+                        emit stateChanged(m_state);
+                    }
+                    onDumUpgradeUnitStateChanged(m_unitRegistry->activeState(unit));
+                    if (!m_unitRegistry->isRunning(unit)) {
+                        FdStore::remove(DUM_FDNAME_UPGRADE_CONNECTION);
+                    }
+                });
+            const auto &progress = m_upgradeSnapshot.progress();
+            auto stage = progress.stage.toUtf8();
+            m_currentProgress = progress;
+            m_progressHistory.append(stage, progress.percent);
+            m_progressStream->publish(stage, progress.percent);
+            m_progressCoalescer->push(progress);
+        } else {
+            FdStore::remove(DUM_FDNAME_UPGRADE_SNAPSHOT);
+            close(snapshotFd);
+        }
     }
 
+    if (connectionFd >= 0) {
+        auto *reader = m_outputReader;
+        QMetaObject::invokeMethod(
+            reader,
+            [reader, connectionFd] {
+                reader->restoreUpgradeStdout(connectionFd);
+            },
+            Qt::QueuedConnection);
+    }
+}
+
+void ManagerAdaptor::abandonRestoredUpgrade()
+{
+    m_upgradeSnapshot.discard();
+    FdStore::remove(DUM_FDNAME_UPGRADE_CONNECTION);
+    m_idle->UnInhibit(STATE_UPGRADING);
+    // 无法确认升级的结果
+    if (m_state == STATE_UPGRADING) {
+        m_state = STATE_FAILED;
+        emit stateChanged(m_state);
+    }
+}
+
+QVariantMap ManagerAdaptor::checkUpgrade(const QDBusMessage &message)
+{
+    m_idle->RecordRequest();
+    message.setDelayedReply(true);
+    QElapsedTimer authorizeTimer;
+    authorizeTimer.start();
+    m_authorizer->checkAuthorization(ACTION_ID_CHECK_UPGRADE,
+                                     message.service(),
+                                     [this, message, authorizeTimer](bool authorized) {
+                                         m_metrics->record("check.authorize",
+                                                           authorizeTimer.elapsed());
+                                         if (!authorized) {
+                                             m_bus.send(message.createErrorReply(
+                                                 QDBusError::AccessDenied,
+                                                 "Not authorized"));
+                                             return;
+                                         }
+
+                                         startCheckUpgrade(message);
+                                     });
+
+    // 延迟回复，返回值不会被使用
+    return {};
+}
+
+QVariantMap ManagerAdaptor::scheduledCheck(const QDBusMessage &message)
+{
+    m_idle->RecordRequest();
+    message.setDelayedReply(true);
+    m_authorizer->checkAuthorization(
+        ACTION_ID_CHECK_UPGRADE,
+        message.service(),
+        [this, message](bool authorized) {
+            if (!authorized) {
+                m_bus.send(message.createErrorReply(QDBusError::AccessDenied, "Not authorized"));
+                return;
+            }
+
+            const auto &config = Config::instance();
+            auto skipped = CheckSchedule::decide({ config.scheduleInterval(),
+                                                   config.scheduleBackoffBase(),
+                                                   config.scheduleBackoffMax() },
+                                                 { m_lastCheckTime,
+                                                   m_checkFailures,
+                                                   m_lastCheckFailure },
+                                                 m_state == STATE_UPGRADING,
+                                                 QDateTime::currentMSecsSinceEpoch());
+            if (!skipped.isEmpty()) {
+                qCInfo(logCheck) << "Scheduled check skipped:" << skipped.value("skipped");
+                m_bus.send(message.createReply(skipped));
+                return;
+            }
+
+            startCheckUpgrade(message);
+        });
+
+    // 延迟回复，返回值不会被使用
+    return {};
+}
+
+void ManagerAdaptor::startCheckUpgrade(const QDBusMessage &message)
+{
     if (m_state == STATE_UPGRADING) {
         m_bus.send(message.createErrorReply(QDBusError::AccessDenied, "An upgrade is in progress"));
         return;
     }
 
-    QString unit = "dum-list-remote-refs.service";
-    auto reply = m_systemdManager->LoadUnit(unit);
-    reply.waitForFinished();
-    if (!reply.isValid()) {
-        m_bus.send(message.createErrorReply(QDBusError::InternalError,
-                                            QString("LoadUnit %1 failed").arg(unit)));
+    // 有效期内直接返回上次检查的结果
+    if (m_lastCheckTimer.isValid()
+        && !m_lastCheckTimer.hasExpired(Config::instance().checkFreshness())) {
+        m_bus.send(message.createReply(m_checkReport));
         return;
     }
 
-    auto unitPath = reply.value();
-    auto *dumListRemoteRefsUnit = new org::freedesktop::systemd1::Unit(SYSTEMD1_SERVICE,
-                                                                       unitPath.path(),
-                                                                       QDBusConnection::systemBus(),
-                                                                       this);
-    auto activeState = dumListRemoteRefsUnit->activeState();
-    if (activeState == "active" || activeState == "activating" || activeState == "deactivating") {
-        m_bus.send(message.createErrorReply(QDBusError::AccessDenied, "An upgrade is in progress"));
+    // 已有检查在进行时，等待该检查完成并共享其结果
+    m_checkUpgradeWaiters.append(message);
+    if (m_checkUpgradeWaiters.size() > 1) {
         return;
     }
+
+    // 检查过程中不阻塞事件循环，检查完成后再回复
     m_idle->Inhibit(STATE_CHECKING);
-    auto reply1 = dumListRemoteRefsUnit->Start("replace");
-    reply1.waitForFinished();
-    if (reply1.isError()) {
-        m_idle->UnInhibit(STATE_CHECKING);
-        m_bus.send(message.createErrorReply(
-            QDBusError::InternalError,
-            QString("Start %1 failed: %2").arg(unit).arg(reply1.error().message())));
+    m_checkTimer.start();
+    m_checkPhaseTimer.start();
+
+#ifdef DUM_WITH_OSTREE
+    if (Config::instance().checkBackend() == DUM_CHECK_BACKEND_OSTREE) {
+        m_ostreeRefLister->list(OSTREE_REPO,
+                                Config::instance().checkRemotes(),
+                                Config::instance().checkRemoteTimeout(),
+                                [this](const OstreeRefLister::Result &result) {
+                                    markPhase(m_checkPhaseTimer, "check.list");
+                                    selectUpgradeTarget(result.currentBranch, result.remotes);
+                                });
         return;
     }
+#endif
+
+    // unit 的代理和状态由 UnitRegistry 缓存，重复检查时不需要再访问 systemd
+    m_unitRegistry->acquire(
+        DUM_LIST_REMOTE_REFS_UNIT,
+        [this](org::freedesktop::systemd1::Unit *proxy, const QString &error) {
+            if (!proxy) {
+                failCheckUpgrade(QDBusError::InternalError, error);
+                return;
+            }
+            markPhase(m_checkPhaseTimer, "check.load-unit");
+
+            // 上一次检查在读完输出后就已结束，unit 停止的信号可能还没有到达
+            m_unitRegistry->waitForStop(DUM_LIST_REMOTE_REFS_UNIT,
+                                        LIST_REMOTE_REFS_STOP_TIMEOUT,
+                                        [this](bool stopped) {
+                                            if (!stopped) {
+                                                failCheckUpgrade(QDBusError::AccessDenied,
+                                                                 "An upgrade is in progress");
+                                                return;
+                                            }
+
+                                            startListRemoteRefsUnit();
+                                        });
+        });
+}
+
+void ManagerAdaptor::startListRemoteRefsUnit()
+{
+    // 先通知 I/O 线程接受输出的连接，再启动 unit
+    auto *reader = m_outputReader;
+    auto check = ++m_checkSequence;
+    m_check = check;
+    m_listRemoteRefsConnected = false;
+    QMetaObject::invokeMethod(
+        reader,
+        [reader, check] {
+            reader->expectListRemoteRefs(check);
+        },
+        Qt::QueuedConnection);
+
+    auto *watcher = new QDBusPendingCallWatcher(
+        m_systemdManager->StartUnit(DUM_LIST_REMOTE_REFS_UNIT, "replace"), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *w) {
+        w->deleteLater();
+        QDBusPendingReply<QDBusObjectPath> reply = *w;
+        if (reply.isError()) {
+            failCheckUpgrade(QDBusError::InternalError,
+                             QString("Start %1 failed: %2")
+                                 .arg(DUM_LIST_REMOTE_REFS_UNIT)
+                                 .arg(reply.error().message()));
+            return;
+        }
+
+        markPhase(m_checkPhaseTimer, "check.start");
+        // 输出的连接可能在 Start 返回之前就已经建立
+        if (!m_listRemoteRefsConnected) {
+            m_listRemoteRefsConnectTimer->start();
+        }
+    });
+}
 
-    if (!m_listRemoteRefsStdoutServer->waitForNewConnection(5000)) {
-        m_idle->UnInhibit(STATE_CHECKING);
-        m_bus.send(message.createErrorReply(QDBusError::InternalError,
-                                            QString("WaitForNewConnection failed")));
+void ManagerAdaptor::onListRemoteRefsConnected(quint64 check)
+{
+    // 检查因超时等原因结束后，I/O 线程可能在收到取消之前已经发出了信号
+    if (check != m_check || m_checkUpgradeWaiters.isEmpty()) {
         return;
     }
 
-    auto *socket = m_listRemoteRefsStdoutServer->nextPendingConnection();
-    // socket->waitForReadyRead();
-    socket->waitForDisconnected();
-    auto output = socket->readAll();
-    socket->deleteLater();
-    m_idle->UnInhibit(STATE_CHECKING);
+    m_listRemoteRefsConnectTimer->stop();
+    markPhase(m_checkPhaseTimer, "check.connect");
+    m_listRemoteRefsConnected = true;
+}
 
-    auto remoteRefs = output.trimmed().split('\n');
-    if (remoteRefs.size() < 1) {
-        m_bus.send(
-            message.createErrorReply(QDBusError::InternalError, "Check upgrade failed: no refs"));
+void ManagerAdaptor::finishCheckUpgrade(quint64 check, const RemoteRefsParser &parser)
+{
+    if (check != m_check || m_checkUpgradeWaiters.isEmpty()) {
         return;
     }
 
-    Branch currentBranchInfo;
-    Branch lastBranchInfo;
-    for (auto ref : remoteRefs) {
-        bool startsWithAsterisk = ref.startsWith('*');
-        if (startsWithAsterisk) {
-            ref.remove(0, 1);
-            ref = ref.trimmed();
-        }
-
-        auto colonIdx = ref.indexOf(' ');
-        if (colonIdx == -1) {
-            qWarning() << "Invalid ref: " << ref;
-            continue;
-        }
+    markPhase(m_checkPhaseTimer, "check.output");
+    if (parser.invalidCount() > 0) {
+        qCWarning(logRefs) << "Ignored" << parser.invalidCount() << "invalid refs";
+    }
+    if (parser.lineCount() < 1) {
+        failCheckUpgrade(QDBusError::InternalError, "Check upgrade failed: no refs");
+        return;
+    }
 
-        auto branch = ref.first(colonIdx).trimmed();
-        if (!branch.startsWith("default:")) {
-            qWarning() << "Invalid branch: " << branch;
-            continue;
-        }
-        branch = branch.sliced(OSTREE_DEFAULT_REMOTE_NAME.length() + 1).trimmed(); // "default:"
-        auto commit = ref.sliced(colonIdx + 1).trimmed();
+    // 所有仓库的分支来自同一次输出，耗时相同
+    auto remotes = parser.catalogs();
+    for (auto &remote : remotes) {
+        remote.elapsed = m_checkTimer.elapsed();
+    }
+    selectUpgradeTarget(parser.currentBranch(), remotes);
+}
 
-        Branch branchInfo(branch);
+void ManagerAdaptor::selectUpgradeTarget(const Branch &currentBranch,
+                                         const QList<RemoteCatalog> &remotes)
+{
+    m_currentBranch = currentBranch;
+    m_refCatalog.clear();
 
-        if (!branchInfo.valid()) {
-            qWarning() << "Invalid branch: " << branch;
+    // 各仓库分别选出最新的分支，再在仓库之间比较，版本相同时优先选择靠前的仓库
+    Branch lastBranchInfo;
+    QByteArray lastRemote;
+    QVariantMap remoteReports;
+    QStringList errors;
+    for (const auto &remote : remotes) {
+        remoteReports.insert(QString::fromUtf8(remote.remote),
+                             QVariantMap{ { "elapsed", remote.elapsed },
+                                          { "refs", remote.refCount },
+                                          { "error", remote.error } });
+        if (!remote.error.isEmpty()) {
+            qCWarning(logCheck) << "Check remote" << remote.remote << "failed:" << remote.error;
+            errors.append(remote.error);
             continue;
         }
+        qCInfo(logCheck) << "Remote" << remote.remote << "refs:" << remote.refCount
+                         << "elapsed:" << remote.elapsed;
 
-        qInfo() << "Branch: " << branch;
-        if (startsWithAsterisk) {
-            currentBranchInfo = branchInfo;
-            continue;
+        auto best = remote.catalog.best(m_currentBranch);
+        if (best.valid() && (!lastBranchInfo.valid() || best.compareVersion(lastBranchInfo) > 0)) {
+            lastBranchInfo = best;
+            lastRemote = remote.remote;
         }
-
-        if (!lastBranchInfo.valid() || lastBranchInfo.canUpgradeTo(branchInfo)) {
-            lastBranchInfo = branchInfo;
-            continue;
+        const auto candidates =
+            remote.catalog.candidates(m_currentBranch, LIST_UPGRADE_TARGETS_LIMIT);
+        for (const auto &branch : candidates) {
+            m_refCatalog.insert(branch);
         }
     }
-
-    qInfo() << "currentBranchInfo:" << currentBranchInfo.toString();
-    qInfo() << "lastBranchInfo:" << lastBranchInfo.toString();
-    if (currentBranchInfo.valid()) {
-        if (!currentBranchInfo.canUpgradeTo(lastBranchInfo)) {
-            lastBranchInfo = Branch();
-        }
+    if (errors.size() == remotes.size()) {
+        failCheckUpgrade(QDBusError::InternalError, errors.join("; "));
+        return;
     }
 
     bool upgradable = lastBranchInfo.valid();
+    Log::event(LOG_INFO,
+               "check-finished",
+               QString("Check finished, current: %1, target: %2")
+                   .arg(m_currentBranch.toString(), lastBranchInfo.toString()),
+               { { "CURRENT_BRANCH", m_currentBranch.toString().toUtf8() },
+                 { "TARGET_BRANCH", lastBranchInfo.toString().toUtf8() },
+                 { "REMOTE", lastRemote },
+                 { "UPGRADABLE", upgradable ? "1" : "0" } });
     if (upgradable) {
         m_remoteBranch = lastBranchInfo.toString();
-        m_settings->setValue("remoteBranch", m_remoteBranch);
+        m_remote = QString::fromUtf8(lastRemote);
+        m_stateStore->setRemoteBranch(m_remoteBranch);
+        m_stateStore->setRemote(m_remote);
     }
     if (m_upgradable != upgradable) {
         m_upgradable = upgradable;
         emit upgradableChanged(m_upgradable);
     }
+
+    m_checkReport = QVariantMap{ { "upgradable", upgradable },
+                                 { "remote", upgradable ? m_remote : QString() },
+                                 { "branch", upgradable ? m_remoteBranch : QString() },
+                                 { "elapsed", m_checkTimer.elapsed() },
+                                 { "remotes", remoteReports } };
+    markPhase(m_checkPhaseTimer, "check.select");
+    m_metrics->record("check.total", m_checkTimer.elapsed());
+    m_lastCheckTimer.start();
+    // 记录检查开始的时间。定时器每天在同一偏移处触发，若记录完成的时间，
+    // 检查的耗时会使下一天的触发被判定为 fresh，实际间隔推迟到 25 小时
+    m_lastCheckTime = QDateTime::currentMSecsSinceEpoch() - m_checkTimer.elapsed();
+    m_checkFailures = 0;
+    m_stateStore->setCheckStats(m_lastCheckTime, m_checkFailures, m_lastCheckFailure);
+    for (const auto &waiter : std::as_const(m_checkUpgradeWaiters)) {
+        m_bus.send(waiter.createReply(m_checkReport));
+    }
+    endCheckUpgrade();
+
+    if (upgradable && Config::instance().prefetch()) {
+        startPrefetch();
+    }
 }
 
-static QString systemdEscape(const QString &str)
+void ManagerAdaptor::failCheckUpgrade(QDBusError::ErrorType type, const QString &message)
 {
-    auto tmp = str;
-    tmp.replace('-', "\\x2d");
-    tmp.replace('/', "-");
+    Log::event(LOG_WARNING,
+               "check-failed",
+               "checkUpgrade failed: " + message,
+               { { "ERROR", message.toUtf8() } });
+    if (m_checkPhaseTimer.isValid()) {
+        m_metrics->record("check.failed", m_checkTimer.elapsed());
+    }
+    // 升级进行中导致的失败不计入退避
+    if (type != QDBusError::AccessDenied) {
+        m_checkFailures++;
+        m_lastCheckFailure = QDateTime::currentMSecsSinceEpoch() - m_checkTimer.elapsed();
+        m_stateStore->setCheckStats(m_lastCheckTime, m_checkFailures, m_lastCheckFailure);
+    }
+    for (const auto &waiter : std::as_const(m_checkUpgradeWaiters)) {
+        m_bus.send(waiter.createErrorReply(type, message));
+    }
+    endCheckUpgrade();
+}
 
-    return tmp;
+void ManagerAdaptor::endCheckUpgrade()
+{
+    m_listRemoteRefsConnectTimer->stop();
+    // 超时等情况下 unit 可能之后才连接，让 I/O 线程不再接受本次检查的输出
+    QMetaObject::invokeMethod(m_outputReader,
+                              &OutputReader::cancelListRemoteRefs,
+                              Qt::QueuedConnection);
+    m_listRemoteRefsConnected = false;
+    m_check = 0;
+    m_checkUpgradeWaiters.clear();
+    m_checkPhaseTimer.invalidate();
+    m_idle->UnInhibit(STATE_CHECKING);
 }
 
+
 void ManagerAdaptor::upgrade(const QDBusMessage &message)
 {
-    if (!checkAuthorization(ACTION_ID_UPGRADE, message.service())) {
-        m_bus.send(message.createErrorReply(QDBusError::AccessDenied, "Not authorized"));
-        return;
-    }
+    m_idle->RecordRequest();
+    message.setDelayedReply(true);
+    QElapsedTimer authorizeTimer;
+    authorizeTimer.start();
+    m_authorizer->checkAuthorization(ACTION_ID_UPGRADE,
+                                     message.service(),
+                                     [this, message, authorizeTimer](bool authorized) {
+                                         m_metrics->record("upgrade.authorize",
+                                                           authorizeTimer.elapsed());
+                                         if (!authorized) {
+                                             m_bus.send(message.createErrorReply(
+                                                 QDBusError::AccessDenied,
+                                                 "Not authorized"));
+                                             return;
+                                         }
+
+                                         startUpgrade(message);
+                                     });
+}
 
-   if (m_state == STATE_SUCCESS) {
-        qInfo() << "Upgrade success, need reboot";
+void ManagerAdaptor::startUpgrade(const QDBusMessage &message)
+{
+    if (m_state == STATE_SUCCESS) {
+        qCInfo(logUpgrade) << "Upgrade success, need reboot";
+        m_bus.send(message.createReply());
         return;
-    } else if (m_state == STATE_CHECKING || m_state == STATE_UPGRADING) {
+    } else if (m_state == STATE_CHECKING || m_state == STATE_UPGRADING
+               || !m_checkUpgradeWaiters.isEmpty()
+               || m_upgradeMessage.type() != QDBusMessage::InvalidMessage) {
         m_bus.send(message.createErrorReply(QDBusError::AccessDenied, "An upgrade is in progress"));
         return;
     }
@@ -252,60 +646,347 @@ void ManagerAdaptor::upgrade(const QDBusMessage &message)
         return;
     }
 
-    QString version = OSTREE_DEFAULT_REMOTE_NAME + ':' + m_remoteBranch;
-    QString unit = QString("dum-upgrade@%1.service").arg(systemdEscape(version));
+    // systemd 接受任务后即回复，升级进度通过 PropertiesChanged 和 progress 信号通知
+    m_upgradeMessage = message;
+    m_idle->Inhibit(STATE_UPGRADING);
+    // 升级会改变当前分支，之前的检查结果不再有效
+    m_lastCheckTimer.invalidate();
+    m_progressCoalescer->reset();
+    m_progressStream->reset();
+    m_progressHistory.clear();
+    m_currentProgress = { QString(), 0 };
+    m_upgradeTimer.start();
+    m_upgradePhaseTimer.start();
+
+    QString unit = QString("dum-upgrade@%1.service").arg(systemdEscape(upgradeVersion()));
+    // dum-upgrade@.service 排在同名的 dum-prefetch@.service 之后，预取未完成时会等待其完成。
+    // 守护进程不跳过升级中的拉取，deepin-immutable-ctl 仍会执行 ostree pull，只是对象已在本地
+    m_unitRegistry->acquire(
+        unit,
+        [this, unit](org::freedesktop::systemd1::Unit *proxy, const QString &error) {
+            if (!proxy) {
+                failUpgrade(QDBusError::InternalError, error);
+                return;
+            }
+
+            markPhase(m_upgradePhaseTimer, "upgrade.load-unit");
+            // 状态变化由 UnitRegistry 在 Start 之前就开始跟踪，不会丢失
+            m_dumUpgradeUnit = proxy;
+            m_dumUpgradeUnitName = unit;
+            if (m_unitRegistry->isRunning(unit)) {
+                failUpgrade(QDBusError::AccessDenied, "An upgrade is in progress");
+                return;
+            }
+
+            m_upgradeSnapshot.create(unit);
+            // 资源配置应用失败时仍按默认配置升级
+            applyResourceProfile(unit, [this, unit](const QString &error) {
+                if (!error.isEmpty()) {
+                    qCWarning(logUpgrade) << "Apply resource profile failed:" << error;
+                }
+                startUpgradeUnit(unit);
+            });
+        });
+}
+
+void ManagerAdaptor::startUpgradeUnit(const QString &unit)
+{
+    auto *watcher = new QDBusPendingCallWatcher(m_dumUpgradeUnit->Start("replace"), this);
+    connect(watcher,
+            &QDBusPendingCallWatcher::finished,
+            this,
+            [this, unit](QDBusPendingCallWatcher *w) {
+                w->deleteLater();
+                QDBusPendingReply<QDBusObjectPath> reply = *w;
+                if (reply.isError()) {
+                    failUpgrade(QDBusError::InternalError,
+                                QString("Start %1 failed: %2")
+                                    .arg(unit)
+                                    .arg(reply.error().message()));
+                    return;
+                }
+
+                markPhase(m_upgradePhaseTimer, "upgrade.start");
+                m_bus.send(std::exchange(m_upgradeMessage, {}).createReply());
+            });
+}
+
+void ManagerAdaptor::setResourceProfile(const QString &profile, const QDBusMessage &message)
+{
+    m_idle->RecordRequest();
+    message.setDelayedReply(true);
+    m_authorizer->checkAuthorization(
+        ACTION_ID_UPGRADE,
+        message.service(),
+        [this, profile, message](bool authorized) {
+            if (!authorized) {
+                m_bus.send(message.createErrorReply(QDBusError::AccessDenied, "Not authorized"));
+                return;
+            }
+            if (!ResourceProfile::isValid(profile)) {
+                m_bus.send(message.createErrorReply(QDBusError::InvalidArgs,
+                                                    QString("Unknown profile: %1").arg(profile)));
+                return;
+            }
 
-    auto reply = m_systemdManager->LoadUnit(unit);
-    reply.waitForFinished();
-    if (!reply.isValid()) {
-        m_bus.send(message.createErrorReply(QDBusError::InternalError,
-                                            QString("GetUnit %1 failed").arg(unit)));
+            if (m_resourceProfile != profile) {
+                m_resourceProfile = profile;
+                emit resourceProfileChanged(m_resourceProfile);
+            }
+
+            if (m_state != STATE_UPGRADING || m_dumUpgradeUnitName.isEmpty()) {
+                m_bus.send(message.createReply());
+                return;
+            }
+
+            applyResourceProfile(m_dumUpgradeUnitName, [this, message](const QString &error) {
+                if (!error.isEmpty()) {
+                    m_bus.send(message.createErrorReply(QDBusError::Failed, error));
+                    return;
+                }
+                m_bus.send(message.createReply());
+            });
+        });
+}
+
+void ManagerAdaptor::setLogLevel(const QString &category,
+                                 const QString &level,
+                                 const QDBusMessage &message)
+{
+    m_idle->RecordRequest();
+    message.setDelayedReply(true);
+    m_authorizer->checkAuthorization(
+        ACTION_ID_CONFIGURE,
+        message.service(),
+        [this, category, level, message](bool authorized) {
+            if (!authorized) {
+                m_bus.send(message.createErrorReply(QDBusError::AccessDenied, "Not authorized"));
+                return;
+            }
+            if (!Log::setLevel(category, level)) {
+                m_bus.send(message.createErrorReply(
+                    QDBusError::InvalidArgs,
+                    QString("Invalid category or level: %1 %2").arg(category, level)));
+                return;
+            }
+
+            qCInfo(logDaemon) << "Log level of" << category << "set to" << level;
+            m_bus.send(message.createReply());
+        });
+}
+
+void ManagerAdaptor::applyResourceProfile(const QString &unit,
+                                          std::function<void(const QString &error)> callback)
+{
+    // 仅在运行时生效，不写入持久的配置
+    auto msg = QDBusMessage::createMethodCall(SYSTEMD1_SERVICE,
+                                              SYSTEMD1_MANAGER_PATH,
+                                              SYSTEMD1_MANAGER_INTERFACE,
+                                              "SetUnitProperties");
+    msg << unit << true << QVariant::fromValue(ResourceProfile::unitProperties(m_resourceProfile));
+
+    auto profile = m_resourceProfile;
+    auto *watcher = new QDBusPendingCallWatcher(m_bus.asyncCall(msg), this);
+    connect(watcher,
+            &QDBusPendingCallWatcher::finished,
+            this,
+            [this, unit, profile, callback = std::move(callback)](QDBusPendingCallWatcher *w) {
+                w->deleteLater();
+                QDBusPendingReply<> reply = *w;
+                if (reply.isError()) {
+                    setResourceLimits({});
+                    callback(QString("SetUnitProperties %1 failed: %2")
+                                 .arg(unit)
+                                 .arg(reply.error().message()));
+                    return;
+                }
+
+                qCInfo(logUpgrade) << "Applied resource profile" << profile << "to" << unit;
+                setResourceLimits(ResourceProfile::limits(profile));
+                callback({});
+            });
+}
+
+void ManagerAdaptor::setResourceLimits(const QVariantMap &limits)
+{
+    if (m_resourceLimits == limits) {
         return;
     }
 
-    if (m_dumUpgradeUnit) {
-        m_bus.disconnect(SYSTEMD1_SERVICE,
-                         m_dumUpgradeUnit->path(),
-                         "org.freedesktop.DBus.Properties",
-                         "PropertiesChanged",
-                         this,
-                         SLOT(onDumUpgradeUnitPropertiesChanged(const QString &,
-                                                                const QVariantMap &,
-                                                                const QStringList &)));
-        m_dumUpgradeUnit->deleteLater();
-    }
+    m_resourceLimits = limits;
+    emit resourceLimitsChanged(m_resourceLimits);
+}
 
-    auto unitPath = reply.value();
-    m_dumUpgradeUnit = new org::freedesktop::systemd1::Unit(SYSTEMD1_SERVICE,
-                                                            unitPath.path(),
-                                                            QDBusConnection::systemBus(),
-                                                            this);
+QString ManagerAdaptor::upgradeVersion() const
+{
+    auto remote = m_remote.isEmpty() ? QString::fromUtf8(OSTREE_DEFAULT_REMOTE_NAME) : m_remote;
+    return remote + ':' + m_remoteBranch;
+}
 
-    auto activeState = m_dumUpgradeUnit->activeState();
-    if (activeState == "active" || activeState == "activating" || activeState == "deactivating") {
-        m_bus.send(message.createErrorReply(QDBusError::AccessDenied, "An upgrade is in progress"));
+void ManagerAdaptor::startPrefetch()
+{
+    QString unit = QString("dum-prefetch@%1.service").arg(systemdEscape(upgradeVersion()));
+    if (unit == m_prefetchUnitName && m_prefetchState != PREFETCH_STATE_FAILED) {
         return;
     }
 
-    m_idle->Inhibit(STATE_UPGRADING);
-    m_bus.connect(SYSTEMD1_SERVICE,
-                  m_dumUpgradeUnit->path(),
-                  "org.freedesktop.DBus.Properties",
-                  "PropertiesChanged",
-                  this,
-                  SLOT(onDumUpgradeUnitPropertiesChanged(const QString &,
-                                                         const QVariantMap &,
-                                                         const QStringList &)));
-
-    auto reply1 = m_dumUpgradeUnit->Start("replace");
-    reply1.waitForFinished();
-    if (reply1.isError()) {
-        m_idle->UnInhibit(STATE_UPGRADING);
-        m_bus.send(message.createErrorReply(
-            QDBusError::InternalError,
-            QString("Start %1 failed: %2").arg(unit).arg(reply1.error().message())));
+    m_prefetchUnitName = unit;
+    m_prefetchJob.clear();
+    m_prefetchRemovedJobs.clear();
+    setPrefetchState(PREFETCH_STATE_PREFETCHING);
+    m_unitRegistry->acquire(
+        unit,
+        [this, unit](org::freedesktop::systemd1::Unit *proxy, const QString &error) {
+            if (unit != m_prefetchUnitName) {
+                return;
+            }
+            if (!proxy) {
+                qCWarning(logUpgrade) << "Prefetch failed:" << error;
+                setPrefetchState(PREFETCH_STATE_FAILED);
+                return;
+            }
+
+            auto *watcher = new QDBusPendingCallWatcher(proxy->Start("replace"), this);
+            connect(watcher,
+                    &QDBusPendingCallWatcher::finished,
+                    this,
+                    [this, unit](QDBusPendingCallWatcher *w) {
+                        w->deleteLater();
+                        QDBusPendingReply<QDBusObjectPath> reply = *w;
+                        if (unit != m_prefetchUnitName) {
+                            return;
+                        }
+                        if (reply.isError()) {
+                            qCWarning(logUpgrade)
+                                << "Start" << unit << "failed:" << reply.error().message();
+                            setPrefetchState(PREFETCH_STATE_FAILED);
+                            return;
+                        }
+
+                        m_prefetchJob = reply.value().path();
+                        auto it = m_prefetchRemovedJobs.constFind(m_prefetchJob);
+                        if (it != m_prefetchRemovedJobs.cend()) {
+                            onPrefetchJobRemoved(it.key(), it.value());
+                        }
+                        m_prefetchRemovedJobs.clear();
+                    });
+        });
+}
+
+void ManagerAdaptor::onPrefetchJobRemoved(const QString &job, const QString &result)
+{
+    if (m_prefetchJob.isEmpty()) {
+        if (m_prefetchState == PREFETCH_STATE_PREFETCHING) {
+            m_prefetchRemovedJobs.insert(job, result);
+        }
         return;
     }
+    if (job != m_prefetchJob) {
+        return;
+    }
+
+    // oneshot unit 的任务在 ExecStart 退出后才结束，result 为 done 表示拉取成功
+    m_prefetchJob.clear();
+    if (result == "done") {
+        setPrefetchState(PREFETCH_STATE_PREFETCHED);
+    } else {
+        qCWarning(logUpgrade) << "Prefetch job" << job << "finished with" << result;
+        setPrefetchState(PREFETCH_STATE_FAILED);
+    }
+}
+
+void ManagerAdaptor::setPrefetchState(const QString &state)
+{
+    if (m_prefetchState != state) {
+        m_prefetchState = state;
+        emit prefetchStateChanged(m_prefetchState);
+    }
+}
+
+void ManagerAdaptor::failUpgrade(QDBusError::ErrorType type, const QString &message)
+{
+    Log::event(LOG_WARNING,
+               "upgrade-failed",
+               "upgrade failed: " + message,
+               { { "ERROR", message.toUtf8() } });
+    m_bus.send(std::exchange(m_upgradeMessage, {}).createErrorReply(type, message));
+    m_upgradeTimer.invalidate();
+    m_upgradePhaseTimer.invalidate();
+    m_upgradeSnapshot.discard();
+    m_idle->UnInhibit(STATE_UPGRADING);
+}
+
+QDBusUnixFileDescriptor ManagerAdaptor::subscribeProgress(const QDBusMessage &message)
+{
+    m_idle->RecordRequest();
+    if (!(m_bus.connectionCapabilities() & QDBusConnection::UnixFileDescriptorPassing)) {
+        message.setDelayedReply(true);
+        m_bus.send(message.createErrorReply(QDBusError::NotSupported,
+                                            "Unix fd passing is not supported"));
+        return {};
+    }
+
+    message.setDelayedReply(true);
+    m_authorizer->checkAuthorization(
+        ACTION_ID_CHECK_UPGRADE,
+        message.service(),
+        [this, message](bool authorized) {
+            if (!authorized) {
+                m_bus.send(message.createErrorReply(QDBusError::AccessDenied, "Not authorized"));
+                return;
+            }
+
+            int fd = m_progressStream->subscribe(message.service());
+            if (fd < 0) {
+                m_bus.send(
+                    message.createErrorReply(QDBusError::LimitsExceeded, "Subscribe failed"));
+                return;
+            }
+            // 调用方断开连接后立即移除其订阅，不必等到下一次发送失败
+            m_progressSubscriberWatcher->addWatchedService(message.service());
+
+            // QDBusUnixFileDescriptor 持有 fd 的副本
+            QDBusUnixFileDescriptor result(fd);
+            close(fd);
+            m_bus.send(message.createReply(QVariant::fromValue(result)));
+        });
+
+    // 延迟回复，返回值不会被使用
+    return {};
+}
+
+QList<ProgressHistoryRecord> ManagerAdaptor::getProgressHistory(qulonglong since) const
+{
+    m_idle->RecordRequest();
+    return m_progressHistory.since(since);
+}
+
+QVariantMap ManagerAdaptor::getStatus() const
+{
+    m_idle->RecordRequest();
+
+    return {
+        { "state", m_state },
+        { "upgradable", m_upgradable },
+        { "remote", m_remote },
+        { "remoteBranch", m_remoteBranch },
+        { "progress", QVariant::fromValue(m_currentProgress) },
+        { "lastCheckTime", m_lastCheckTime },
+        { "prefetchState", m_prefetchState },
+        { "resourceProfile", m_resourceProfile },
+    };
+}
+
+QStringList ManagerAdaptor::listUpgradeTargets() const
+{
+    m_idle->RecordRequest();
+    QStringList targets;
+    for (const auto &branch :
+         m_refCatalog.candidates(m_currentBranch, LIST_UPGRADE_TARGETS_LIMIT)) {
+        targets.append(branch.toString());
+    }
+
+    return targets;
 }
 
 bool ManagerAdaptor::upgradable() const
@@ -318,92 +999,169 @@ QString ManagerAdaptor::state() const
     return m_state;
 }
 
-void ManagerAdaptor::onDumUpgradeUnitPropertiesChanged(const QString &interfaceName,
-                                                       const QVariantMap &changedProperties,
-                                                       const QStringList &invalidatedProperties)
+double ManagerAdaptor::progressMaxRate() const
 {
-    if (interfaceName == "org.freedesktop.systemd1.Unit") {
-        auto activeState = changedProperties.value("ActiveState").toString();
-        qWarning() << "activeState:" << activeState;
-        if (activeState == "active" || activeState == "activating") {
-            m_state = STATE_UPGRADING;
-            emit stateChanged(m_state);
-        } else if (activeState == "deactivating") {
+    return m_progressCoalescer->maxRate();
+}
+
+double ManagerAdaptor::progressMinDelta() const
+{
+    return m_progressCoalescer->minDelta();
+}
+
+QString ManagerAdaptor::prefetchState() const
+{
+    return m_prefetchState;
+}
+
+Progress ManagerAdaptor::currentProgress() const
+{
+    return m_currentProgress;
+}
+
+QVariantMap ManagerAdaptor::stageDurations() const
+{
+    return m_progressHistory.stageDurations();
+}
+
+uint ManagerAdaptor::restartCount() const
+{
+    return m_idle->restartCount();
+}
+
+qlonglong ManagerAdaptor::coldStartTime() const
+{
+    return m_idle->coldStartCost();
+}
+
+int ManagerAdaptor::idleTimeout() const
+{
+    return m_idle->timeout();
+}
+
+QString ManagerAdaptor::resourceProfile() const
+{
+    return m_resourceProfile;
+}
+
+QVariantMap ManagerAdaptor::resourceLimits() const
+{
+    return m_resourceLimits;
+}
+
+qulonglong ManagerAdaptor::progressSuppressed() const
+{
+    return m_progressCoalescer->suppressed();
+}
+
+void ManagerAdaptor::onDumUpgradeUnitStateChanged(const QString &activeState)
+{
+    qCInfo(logUpgrade) << "Upgrade unit activeState:" << activeState;
+    if (activeState == "active" || activeState == "activating") {
+        m_state = STATE_UPGRADING;
+        emit stateChanged(m_state);
+    } else if (activeState == "deactivating") {
+        m_state = STATE_SUCCESS;
+        emit stateChanged(m_state);
+
+        m_upgradable = false;
+        emit upgradableChanged(m_upgradable);
+    } else if (activeState == "failed") {
+        m_state = STATE_FAILED;
+        emit stateChanged(m_state);
+    } else if (activeState == "inactive") {
+        if (m_state == STATE_UPGRADING) {
             m_state = STATE_SUCCESS;
             emit stateChanged(m_state);
 
             m_upgradable = false;
             emit upgradableChanged(m_upgradable);
-        } else if (activeState == "failed") {
-            m_state = STATE_FAILED;
-            emit stateChanged(m_state);
-        } else if (activeState == "inactive") {
-            if (m_state == STATE_UPGRADING) {
-                m_state = STATE_SUCCESS;
-                emit stateChanged(m_state);
-
-                m_upgradable = false;
-                emit upgradableChanged(m_upgradable);
-            }
-        } else {
-            qWarning() << "unknown activeState:" << activeState;
         }
+    } else {
+        qCWarning(logUpgrade) << "Unknown activeState:" << activeState;
     }
     if (m_state == STATE_SUCCESS || m_state == STATE_FAILED) {
+        Log::event(m_state == STATE_SUCCESS ? LOG_INFO : LOG_WARNING,
+                   "upgrade-finished",
+                   QString("Upgrade %1 finished: %2").arg(m_dumUpgradeUnitName, m_state),
+                   { { "UNIT", m_dumUpgradeUnitName.toUtf8() },
+                     { "STATE", m_state.toUtf8() },
+                     { "REMOTE_BRANCH", m_remoteBranch.toUtf8() } });
+        // 恢复的升级没有开始时间，不计入统计
+        if (m_upgradeTimer.isValid()) {
+            markPhase(m_upgradePhaseTimer, "upgrade.run");
+            m_metrics->record(m_state == STATE_SUCCESS ? "upgrade.total" : "upgrade.failed",
+                              m_upgradeTimer.elapsed());
+            m_upgradeTimer.invalidate();
+            m_upgradePhaseTimer.invalidate();
+        }
+        m_upgradeSnapshot.discard();
         m_idle->UnInhibit(STATE_UPGRADING);
     }
 }
 
-static const QByteArray PROGRESS_PREFIX = "progressRate:";
-
-void ManagerAdaptor::parseUpgradeStdoutLine(const QByteArray &line)
+void ManagerAdaptor::onUpgradeProgress(const QByteArray &stage,
+                                       float percent,
+                                       const QElapsedTimer &parsed)
 {
-    if (line.startsWith(PROGRESS_PREFIX)) {
-        auto tmp = QByteArrayView(line.begin() + PROGRESS_PREFIX.size(), line.end()).trimmed();
-        auto colonIdx = tmp.indexOf(':');
-        QString percentStr = tmp.sliced(0, colonIdx).trimmed().toByteArray();
-        QString stage = tmp.sliced(colonIdx + 1).trimmed().toByteArray();
+    // 从 I/O 线程解析出进度到在当前线程处理的延迟，只计入直方图
+    m_metrics->sample("progress.forward", parsed.elapsed());
+
+    // 订阅者收到每一条进度，progress 信号经过合并
+    m_progressHistory.append(stage, percent);
+    m_progressStream->publish(stage, percent);
+    m_currentProgress = { QString::fromUtf8(stage), percent };
+    m_progressCoalescer->push(m_currentProgress);
+}
 
-        emit progress({ stage, percentStr.toFloat() });
+void ManagerAdaptor::markPhase(QElapsedTimer &timer, const QString &phase)
+{
+    if (timer.isValid()) {
+        m_metrics->record(phase, timer.restart());
     }
 }
 
 void ManagerAdaptor::sendPropertyChanged(const QString &property, const QVariant &value)
 {
+    // 同一轮事件循环中的修改合并为一个 PropertiesChanged 信号，同一属性只保留最新的值
+    m_changedProperties.insert(property, value);
+    if (!m_propertiesChangedTimer->isActive()) {
+        m_propertiesChangedTimer->start();
+    }
+}
+
+void ManagerAdaptor::flushPropertiesChanged()
+{
+    if (m_changedProperties.isEmpty()) {
+        return;
+    }
+
     auto msg = QDBusMessage::createSignal(ADAPTOR_PATH,
                                           "org.freedesktop.DBus.Properties",
                                           "PropertiesChanged");
     msg << "org.deepin.UpdateManager1";
-    msg << QVariantMap{ { property, value } };
+    msg << std::exchange(m_changedProperties, {});
     msg << QStringList{};
 
     auto res = m_bus.send(msg);
     if (!res) {
-        qWarning() << "sendPropertyChanged failed";
-    }
-}
-
-bool ManagerAdaptor::checkAuthorization(const QString &actionId, const QString &service) const
-{
-    auto pid = m_bus.interface()->servicePid(service).value();
-    auto authority = PolkitQt1::Authority::instance();
-    auto result = authority->checkAuthorizationSync(actionId,
-                                                    PolkitQt1::UnixProcessSubject(pid),
-                                                    PolkitQt1::Authority::AllowUserInteraction);
-    if (authority->hasError()) {
-        qWarning() << "checkAuthorizationSync failed:" << authority->lastError()
-                   << authority->errorDetails();
-        return false;
+        qCWarning(logDaemon) << "sendPropertyChanged failed";
     }
-
-    return result == PolkitQt1::Authority::Result::Yes;
 }
 
 void ManagerAdaptor::loadStatus()
 {
-    if (m_settings) {
-        m_state = m_settings->value("state",STATE_IDEL).toString();
-        m_upgradable = m_settings->value("upgradable",false).toBool();
-        m_remoteBranch = m_settings->value("remoteBranch","").toString();
+    m_state = m_stateStore->state().isEmpty() ? STATE_IDEL : m_stateStore->state();
+    m_upgradable = m_stateStore->upgradable();
+    m_remoteBranch = m_stateStore->remoteBranch();
+    m_remote = m_stateStore->remote();
+    m_lastCheckTime = m_stateStore->lastCheckTime();
+    m_checkFailures = m_stateStore->checkFailures();
+    m_lastCheckFailure = m_stateStore->lastCheckFailure();
+    m_idle->Restore(m_stateStore->restartCount() + 1,
+                    m_stateStore->interArrival(),
+                    m_stateStore->lastRequest());
+    if (ResourceProfile::isValid(m_stateStore->resourceProfile())) {
+        m_resourceProfile = m_stateStore->resourceProfile();
     }
 }
\ No newline at end of file
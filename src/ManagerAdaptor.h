@@ -7,22 +7,32 @@
 #include "SystemdManagerInterface.h"
 #include "SystemdUnitInterface.h"
 #include "Idle.h"
-
-#include <QLocalServer>
+#include "Progress.h"
+#include "ProgressCoalescer.h"
+#include "ProgressHistory.h"
+#include "RemoteRefsParser.h"
+#include "UpgradeSnapshot.h"
+
+#include <QDBusMessage>
+#include <QDBusServiceWatcher>
+#include <QDBusUnixFileDescriptor>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
-#include <QSettings>
+#include <QThread>
+#include <QTimer>
 
-#define ADAPTOR_PATH "/org/deepin/UpdateManager1"
+#include <functional>
 
-struct Progress
-{
-    QString stage;
-    float percent;
-};
-Q_DECLARE_METATYPE(Progress)
+class Authorizer;
+class MetricsAdaptor;
+class OstreeRefLister;
+class OutputReader;
+class ProgressStream;
+class StateStore;
+class UnitRegistry;
 
-QDBusArgument &operator<<(QDBusArgument &argument, const Progress &progress);
-const QDBusArgument &operator>>(const QDBusArgument &argument, Progress &progress);
+#define ADAPTOR_PATH "/org/deepin/UpdateManager1"
 
 class ManagerAdaptor : public QObject
 {
@@ -30,6 +40,21 @@ class ManagerAdaptor : public QObject
     Q_CLASSINFO("D-Bus Interface", "org.deepin.UpdateManager1")
     Q_PROPERTY(bool upgradable READ upgradable NOTIFY upgradableChanged SCRIPTABLE true)
     Q_PROPERTY(QString state READ state NOTIFY stateChanged SCRIPTABLE true)
+    Q_PROPERTY(double progressMaxRate READ progressMaxRate CONSTANT SCRIPTABLE true)
+    Q_PROPERTY(double progressMinDelta READ progressMinDelta CONSTANT SCRIPTABLE true)
+    Q_PROPERTY(qulonglong progressSuppressed READ progressSuppressed SCRIPTABLE true)
+    Q_PROPERTY(Progress currentProgress READ currentProgress SCRIPTABLE true)
+    Q_PROPERTY(QVariantMap stageDurations READ stageDurations SCRIPTABLE true)
+    Q_PROPERTY(QString prefetchState READ prefetchState NOTIFY prefetchStateChanged SCRIPTABLE true)
+    Q_PROPERTY(QString resourceProfile READ resourceProfile NOTIFY resourceProfileChanged
+                   SCRIPTABLE true)
+    // 最近一次成功应用到升级 unit 的资源限制，未应用或应用失败时为空
+    Q_PROPERTY(QVariantMap resourceLimits READ resourceLimits NOTIFY resourceLimitsChanged
+                   SCRIPTABLE true)
+    Q_PROPERTY(uint restartCount READ restartCount CONSTANT SCRIPTABLE true)
+    Q_PROPERTY(qlonglong coldStartTime READ coldStartTime NOTIFY coldStartTimeChanged
+                   SCRIPTABLE true)
+    Q_PROPERTY(int idleTimeout READ idleTimeout NOTIFY idleTimeoutChanged SCRIPTABLE true)
 
 public:
     ManagerAdaptor(int listRemoteRefsFd,
@@ -38,18 +63,58 @@ public:
                    QObject *parent = nullptr);
     ~ManagerAdaptor() override;
 
+    // 恢复守护进程重启前进行中的升级，fd 为从 fd store 中取回的输出连接和快照，不存在时为 -1
+    void restoreUpgrade(int connectionFd, int snapshotFd);
+    // 进程启动到进入事件循环的耗时（毫秒），用于调整空闲退出的超时时间
+    void setColdStartCost(qint64 cost);
+
     /* dbus start */
 public slots:
-    Q_SCRIPTABLE void checkUpgrade(const QDBusMessage &message);
+    // 返回选中的远程仓库、分支以及各仓库的耗时
+    Q_SCRIPTABLE QVariantMap checkUpgrade(const QDBusMessage &message);
+    // 供 dum-check.timer 调用。距上次成功检查不足间隔或处于失败后的退避期时跳过，
+    // 返回 skipped（fresh、backoff 或 upgrading）；否则与 checkUpgrade 相同
+    Q_SCRIPTABLE QVariantMap scheduledCheck(const QDBusMessage &message);
     Q_SCRIPTABLE void upgrade(const QDBusMessage &message);
+    Q_SCRIPTABLE QStringList listUpgradeTargets() const;
+    // 一次返回 state、upgradable、目标分支、当前进度和上次检查的时间（自 1970 年起的毫秒数，0 表示未检查）
+    Q_SCRIPTABLE QVariantMap getStatus() const;
+    // 序号大于 since 的进度记录，since 为 0 时返回保留的全部记录
+    Q_SCRIPTABLE QList<ProgressHistoryRecord> getProgressHistory(qulonglong since) const;
+    // 返回只读的 SOCK_SEQPACKET fd，逐条接收固定长度的 ProgressRecord，第一条为当前进度。
+    // 需要 check-upgrade 授权，每个连接最多 DUM_PROGRESS_STREAM_OWNER_LIMIT 个订阅
+    Q_SCRIPTABLE QDBusUnixFileDescriptor subscribeProgress(const QDBusMessage &message);
+    // 切换升级的资源配置，升级进行中时立即应用到升级的 unit
+    Q_SCRIPTABLE void setResourceProfile(const QString &profile, const QDBusMessage &message);
+    // 修改日志分类的级别，category 为 check、refs、upgrade、io、daemon 或 *，level 为 debug、info、
+    // warning、critical。只对当前进程有效，空闲退出后恢复默认
+    Q_SCRIPTABLE void setLogLevel(const QString &category,
+                                  const QString &level,
+                                  const QDBusMessage &message);
 
 public slots:
     bool upgradable() const;
     QString state() const;
+    double progressMaxRate() const;
+    double progressMinDelta() const;
+    qulonglong progressSuppressed() const;
+    Progress currentProgress() const;
+    QVariantMap stageDurations() const;
+    QString prefetchState() const;
+    QString resourceProfile() const;
+    QVariantMap resourceLimits() const;
+    uint restartCount() const;
+    qlonglong coldStartTime() const;
+    int idleTimeout() const;
 
 signals:
     void upgradableChanged(bool upgradable);
     void stateChanged(const QString &state);
+    void prefetchStateChanged(const QString &state);
+    void resourceProfileChanged(const QString &profile);
+    void resourceLimitsChanged(const QVariantMap &limits);
+    void coldStartTimeChanged(qlonglong coldStartTime);
+    void idleTimeoutChanged(int idleTimeout);
 
 signals:
     Q_SCRIPTABLE void progress(const Progress &progress);
@@ -57,25 +122,101 @@ signals:
 
 private:
     QDBusConnection m_bus;
-    QLocalServer *m_listRemoteRefsStdoutServer;
-    QLocalServer *m_upgradeStdoutServer;
+    // 读取 unit 输出的 I/O 线程
+    QThread m_ioThread;
+    OutputReader *m_outputReader;
     org::freedesktop::systemd1::Manager *m_systemdManager;
+    UnitRegistry *m_unitRegistry;
     org::freedesktop::systemd1::Unit *m_dumUpgradeUnit;
+    QString m_dumUpgradeUnitName;
     QString m_remoteBranch;
+    QString m_remote;
+    // 预取升级内容的 unit，只对最近一次检查得到的目标分支预取
+    QString m_prefetchUnitName;
+    QString m_prefetchState;
+    // 本次预取的 Start 返回的任务，预取状态只由该任务的结果决定。
+    // unit 首次加载时读到的 inactive 或上次遗留的 failed 都不是本次预取的结果
+    QString m_prefetchJob;
+    // Start 回复之前就已结束的预取任务及其结果
+    QHash<QString, QString> m_prefetchRemovedJobs;
+    QString m_resourceProfile;
+    QVariantMap m_resourceLimits;
+
+    // checkUpgrade 以延迟回复的方式异步执行，以下为进行中的检查的状态。
+    // 同一时间只进行一次检查，检查期间到达的调用都等待该检查的结果
+    QList<QDBusMessage> m_checkUpgradeWaiters;
+    QTimer *m_listRemoteRefsConnectTimer;
+    // 进行中的检查的编号，0 表示没有进行中的检查。编号取自只增不减的 m_checkSequence，
+    // 用于忽略已结束的检查迟到的输出
+    quint64 m_check;
+    quint64 m_checkSequence;
+    bool m_listRemoteRefsConnected;
+    QElapsedTimer m_checkTimer;
+    // 最近一次检查得到的当前分支和远程分支
+    Branch m_currentBranch;
+    RefCatalog m_refCatalog;
+    // 上次成功检查的时间，用于判断检查结果是否仍然有效
+    QElapsedTimer m_lastCheckTimer;
+    // 上次成功检查的结果，作为 checkUpgrade 的返回值
+    QVariantMap m_checkReport;
+
+    // 进行中的 upgrade 调用，systemd 接受任务后回复
+    QDBusMessage m_upgradeMessage;
 
     bool m_upgradable;
     QString m_state;
     Idle *m_idle;
-    QSettings *m_settings;
-
-private slots:
-    void onDumUpgradeUnitPropertiesChanged(const QString &interfaceName,
-                                           const QVariantMap &changedProperties,
-                                           const QStringList &invalidatedProperties);
+    Authorizer *m_authorizer;
+    ProgressCoalescer *m_progressCoalescer;
+    StateStore *m_stateStore;
+    ProgressStream *m_progressStream;
+    MetricsAdaptor *m_metrics;
+    // 进行中的检查和升级当前阶段的开始时间，以及升级的开始时间
+    QElapsedTimer m_checkPhaseTimer;
+    QElapsedTimer m_upgradePhaseTimer;
+    QElapsedTimer m_upgradeTimer;
+    UpgradeSnapshot m_upgradeSnapshot;
+    // 最近一条未经合并的进度
+    Progress m_currentProgress;
+    ProgressHistory m_progressHistory;
+    // 进度订阅者的 D-Bus 连接
+    QDBusServiceWatcher *m_progressSubscriberWatcher;
+    // 待发送的属性变化
+    QTimer *m_propertiesChangedTimer;
+    QVariantMap m_changedProperties;
+    qint64 m_lastCheckTime;
+    // 上次成功检查之后连续失败的次数和最近一次失败的时间，用于定时检查的退避
+    quint32 m_checkFailures;
+    qint64 m_lastCheckFailure;
+#ifdef DUM_WITH_OSTREE
+    OstreeRefLister *m_ostreeRefLister;
+#endif
 
 private:
-    void parseUpgradeStdoutLine(const QByteArray &line);
+    void startCheckUpgrade(const QDBusMessage &message);
+    void startListRemoteRefsUnit();
+    void onListRemoteRefsConnected(quint64 check);
+    void finishCheckUpgrade(quint64 check, const RemoteRefsParser &parser);
+    void selectUpgradeTarget(const Branch &currentBranch, const QList<RemoteCatalog> &remotes);
+    void failCheckUpgrade(QDBusError::ErrorType type, const QString &message);
+    void endCheckUpgrade();
+    void startUpgrade(const QDBusMessage &message);
+    void startUpgradeUnit(const QString &unit);
+    void failUpgrade(QDBusError::ErrorType type, const QString &message);
+    QString upgradeVersion() const;
+    void applyResourceProfile(const QString &unit,
+                              std::function<void(const QString &error)> callback);
+    void setResourceLimits(const QVariantMap &limits);
+    void startPrefetch();
+    void onPrefetchJobRemoved(const QString &job, const QString &result);
+    void setPrefetchState(const QString &state);
+    // 恢复的升级无法重新关联 unit 时，清理快照和 fd store 并解除空闲抑制
+    void abandonRestoredUpgrade();
+    void onDumUpgradeUnitStateChanged(const QString &activeState);
+    void onUpgradeProgress(const QByteArray &stage, float percent, const QElapsedTimer &parsed);
+    // 记录从 timer 开始到现在的阶段耗时，并重新开始计时
+    void markPhase(QElapsedTimer &timer, const QString &phase);
     void sendPropertyChanged(const QString &property, const QVariant &value);
-    bool checkAuthorization(const QString &actionId, const QString &service) const;
+    void flushPropertiesChanged();
     void loadStatus();
 };
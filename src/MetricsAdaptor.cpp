@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "MetricsAdaptor.h"
+
+#include <systemd/sd-journal.h>
+
+#include <algorithm>
+
+// 各个桶的上限（毫秒），最后一个桶不设上限
+static const std::array<qint64, DUM_METRICS_BUCKETS - 1> BUCKET_BOUNDS = {
+    1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000, 120000, 300000,
+    900000, 3600000,
+};
+
+MetricsAdaptor::MetricsAdaptor(QObject *parent)
+    : QDBusAbstractAdaptor(parent)
+{
+}
+
+void MetricsAdaptor::record(const QString &phase, qint64 elapsed)
+{
+    sample(phase, elapsed);
+
+    auto name = phase.toUtf8();
+    sd_journal_send("MESSAGE=%s took %lld ms",
+                    name.constData(),
+                    static_cast<long long>(elapsed),
+                    "PRIORITY=6",
+                    "DUM_PHASE=%s",
+                    name.constData(),
+                    "DUM_DURATION_MS=%lld",
+                    static_cast<long long>(elapsed),
+                    nullptr);
+}
+
+void MetricsAdaptor::sample(const QString &phase, qint64 elapsed)
+{
+    auto bucket = std::lower_bound(BUCKET_BOUNDS.begin(), BUCKET_BOUNDS.end(), elapsed)
+        - BUCKET_BOUNDS.begin();
+
+    auto &histogram = m_histograms[phase];
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    histogram.sum += elapsed;
+    histogram.last = elapsed;
+}
+
+qint64 MetricsAdaptor::percentile(const Histogram &histogram, double q)
+{
+    // 返回累计数量达到 q 的桶的上限，最后一个桶返回最大的上限
+    auto target = quint64(histogram.count * q + 0.5);
+    quint64 accumulated = 0;
+    for (int i = 0; i < DUM_METRICS_BUCKETS - 1; i++) {
+        accumulated += histogram.buckets[i];
+        if (accumulated >= qMax<quint64>(target, 1)) {
+            return BUCKET_BOUNDS[i];
+        }
+    }
+
+    return BUCKET_BOUNDS.back();
+}
+
+QVariantMap MetricsAdaptor::getMetrics() const
+{
+    QVariantMap metrics;
+    for (auto it = m_histograms.cbegin(); it != m_histograms.cend(); ++it) {
+        const auto &histogram = it.value();
+        metrics.insert(it.key(),
+                       QVariantMap{
+                           { "count", histogram.count },
+                           { "sum", histogram.sum },
+                           { "last", histogram.last },
+                           { "p50", percentile(histogram, 0.50) },
+                           { "p95", percentile(histogram, 0.95) },
+                           { "p99", percentile(histogram, 0.99) },
+                       });
+    }
+
+    return metrics;
+}
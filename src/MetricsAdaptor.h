@@ -0,0 +1,46 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QDBusAbstractAdaptor>
+#include <QHash>
+#include <QVariantMap>
+
+#include <array>
+
+// 直方图的桶数，最后一个桶不设上限
+#define DUM_METRICS_BUCKETS 20
+
+// org.deepin.UpdateManager1.Metrics 接口。
+// 记录检查和升级各阶段的耗时，按固定的桶统计为直方图，同时以结构化字段写入日志
+class MetricsAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.deepin.UpdateManager1.Metrics")
+public:
+    explicit MetricsAdaptor(QObject *parent);
+
+    // elapsed 为毫秒
+    void record(const QString &phase, qint64 elapsed);
+    // 只计入直方图，不写日志，用于频繁发生的事件
+    void sample(const QString &phase, qint64 elapsed);
+
+public slots:
+    // 阶段名到 a{sv} 的映射，包括 count、sum、last、p50、p95、p99，时间单位为毫秒
+    QVariantMap getMetrics() const;
+
+private:
+    struct Histogram
+    {
+        std::array<quint64, DUM_METRICS_BUCKETS> buckets{};
+        quint64 count = 0;
+        qint64 sum = 0;
+        qint64 last = 0;
+    };
+
+    static qint64 percentile(const Histogram &histogram, double q);
+
+    QHash<QString, Histogram> m_histograms;
+};
@@ -0,0 +1,227 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// glib 的头文件中使用了 signals 作为字段名，需要在 Qt 的宏生效之前包含
+#pragma push_macro("signals")
+#undef signals
+#include <ostree.h>
+#pragma pop_macro("signals")
+
+#include "OstreeRefLister.h"
+
+#include "Log.h"
+
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include <memory>
+
+static QString takeError(GError **error)
+{
+    QString message = QString::fromUtf8(*error ? (*error)->message : "unknown error");
+    g_clear_error(error);
+
+    return message;
+}
+
+// 已启动部署的 origin 中记录的 refspec（格式为 remote:ref）中的 ref
+static QByteArray bootedRef(GCancellable *cancellable)
+{
+    GError *error = nullptr;
+    g_autoptr(OstreeSysroot) sysroot = ostree_sysroot_new_default();
+    if (!ostree_sysroot_load(sysroot, cancellable, &error)) {
+        qCWarning(logCheck) << "Load sysroot failed:" << takeError(&error);
+        return {};
+    }
+
+    auto *deployment = ostree_sysroot_get_booted_deployment(sysroot);
+    if (!deployment) {
+        qCWarning(logCheck) << "No booted deployment";
+        return {};
+    }
+
+    auto *origin = ostree_deployment_get_origin(deployment);
+    if (!origin) {
+        return {};
+    }
+
+    g_autofree char *refspec = g_key_file_get_string(origin, "origin", "refspec", nullptr);
+    g_autofree char *ref = nullptr;
+    if (!refspec || !ostree_parse_refspec(refspec, nullptr, &ref, &error)) {
+        qCWarning(logCheck) << "Invalid origin refspec:" << takeError(&error);
+        return {};
+    }
+
+    return QByteArray(ref);
+}
+
+OstreeRepo *OstreeRefLister::openRepo(const QByteArray &repoPath,
+                                      GCancellable *cancellable,
+                                      QString *error)
+{
+    QMutexLocker locker(&m_repoMutex);
+    if (m_repo && m_repoPath == repoPath) {
+        return static_cast<OstreeRepo *>(g_object_ref(m_repo));
+    }
+
+    GError *gerror = nullptr;
+    g_autoptr(GFile) file = g_file_new_for_path(repoPath.constData());
+    g_autoptr(OstreeRepo) repo = ostree_repo_new(file);
+    if (!ostree_repo_open(repo, cancellable, &gerror)) {
+        *error = takeError(&gerror);
+        return nullptr;
+    }
+
+    // 其它线程可能仍在使用之前的仓库，它们各自持有引用
+    g_clear_object(&m_repo);
+    m_repo = static_cast<OstreeRepo *>(g_object_ref(repo));
+    m_repoPath = repoPath;
+    return static_cast<OstreeRepo *>(g_steal_pointer(&repo));
+}
+
+RemoteCatalog OstreeRefLister::listRefs(const QByteArray &repoPath,
+                                        const QByteArray &remote,
+                                        GCancellable *cancellable)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    RemoteCatalog result;
+    result.remote = remote;
+
+    QString message;
+    GError *error = nullptr;
+    g_autoptr(OstreeRepo) repo = openRepo(repoPath, cancellable, &message);
+    g_autoptr(GHashTable) refs = nullptr;
+    if (!repo
+        || !ostree_repo_remote_list_refs(repo, remote.constData(), &refs, cancellable, &error)) {
+        if (repo) {
+            message = takeError(&error);
+        }
+        result.error = g_cancellable_is_cancelled(cancellable)
+            ? QString("Timed out")
+            : QString("List refs of %1 failed: %2").arg(remote).arg(message);
+        result.elapsed = timer.elapsed();
+        return result;
+    }
+
+    int invalid = 0;
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, refs);
+    while (g_hash_table_iter_next(&iter, &key, nullptr)) {
+        Branch branch{ QByteArrayView(static_cast<const char *>(key)) };
+        if (!branch.valid()) {
+            invalid++;
+            continue;
+        }
+
+        result.refCount++;
+        result.catalog.insert(branch);
+    }
+    if (invalid > 0) {
+        qCWarning(logRefs) << "Ignored" << invalid << "invalid refs of" << remote;
+    }
+
+    result.elapsed = timer.elapsed();
+    return result;
+}
+
+OstreeRefLister::OstreeRefLister(QObject *parent)
+    : QObject(parent)
+    , m_repo(nullptr)
+{
+}
+
+OstreeRefLister::~OstreeRefLister()
+{
+    // 取消进行中的网络请求并等待工作线程退出，此后投递给本对象的回调会随对象一起丢弃
+    for (auto *cancellable : std::as_const(m_pending)) {
+        g_cancellable_cancel(cancellable);
+    }
+    m_pool.waitForDone();
+    for (auto *cancellable : std::as_const(m_pending)) {
+        g_object_unref(cancellable);
+    }
+    g_clear_object(&m_repo);
+}
+
+void OstreeRefLister::run(std::function<void(GCancellable *)> task, int timeout)
+{
+    auto *cancellable = g_cancellable_new();
+    m_pending.insert(cancellable);
+    if (timeout > 0) {
+        QTimer::singleShot(timeout, this, [this, cancellable] {
+            if (m_pending.contains(cancellable)) {
+                g_cancellable_cancel(cancellable);
+            }
+        });
+    }
+
+    m_pool.start([this, task = std::move(task), cancellable] {
+        task(cancellable);
+        QMetaObject::invokeMethod(
+            this,
+            [this, cancellable] {
+                m_pending.remove(cancellable);
+                g_object_unref(cancellable);
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void OstreeRefLister::list(const QString &repoPath,
+                           const QByteArrayList &remotes,
+                           int timeout,
+                           Callback callback)
+{
+    // 各个任务的结果在当前线程中汇总，全部完成后回调
+    struct State
+    {
+        Result result;
+        int remaining = 0;
+        Callback callback;
+    };
+    auto state = std::make_shared<State>();
+    state->remaining = remotes.size() + 1;
+    state->callback = std::move(callback);
+    for (const auto &remote : remotes) {
+        state->result.remotes.append({ remote });
+    }
+
+    auto finish = [state] {
+        if (--state->remaining == 0) {
+            state->callback(state->result);
+        }
+    };
+
+    run(
+        [this, state, finish](GCancellable *cancellable) {
+            auto currentBranch = Branch(QByteArrayView(bootedRef(cancellable)));
+            QMetaObject::invokeMethod(
+                this,
+                [state, finish, currentBranch] {
+                    state->result.currentBranch = currentBranch;
+                    finish();
+                },
+                Qt::QueuedConnection);
+        },
+        timeout);
+
+    auto path = repoPath.toUtf8();
+    for (int i = 0; i < remotes.size(); i++) {
+        run(
+            [this, state, finish, path, remote = remotes.at(i), i](GCancellable *cancellable) {
+                auto catalog = listRefs(path, remote, cancellable);
+                QMetaObject::invokeMethod(
+                    this,
+                    [state, finish, i, catalog = std::move(catalog)] {
+                        state->result.remotes[i] = catalog;
+                        finish();
+                    },
+                    Qt::QueuedConnection);
+            },
+            timeout);
+    }
+}
@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "Branch.h"
+#include "RefCatalog.h"
+
+#include <QByteArrayList>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QThreadPool>
+
+#include <functional>
+
+typedef struct _GCancellable GCancellable;
+typedef struct OstreeRepo OstreeRepo;
+
+// 在工作线程中通过 libostree 直接读取远程分支，不再启动 dum-list-remote-refs.service 并解析其文本输出。
+// 每个远程仓库在单独的线程中并行读取，超时的仓库会被取消，不影响其它仓库的结果。
+// 当前分支取自已启动部署的 origin。仓库只在第一次列出时打开，之后的检查复用，
+// 仓库的远程配置因此在进程退出前不会重新读取。
+class OstreeRefLister : public QObject
+{
+    Q_OBJECT
+public:
+    struct Result
+    {
+        Branch currentBranch;
+        // 按 remotes 的顺序排列
+        QList<RemoteCatalog> remotes;
+    };
+
+    using Callback = std::function<void(const Result &result)>;
+
+    explicit OstreeRefLister(QObject *parent = nullptr);
+    ~OstreeRefLister() override;
+
+    // 列出 repoPath 中各个 remote 的远程分支，全部完成或超时后在当前对象所在线程回调
+    void list(const QString &repoPath,
+              const QByteArrayList &remotes,
+              int timeout,
+              Callback callback);
+
+private:
+    void run(std::function<void(GCancellable *)> task, int timeout);
+    // 在工作线程中调用，返回的仓库需要调用方释放引用，失败时为 nullptr
+    OstreeRepo *openRepo(const QByteArray &repoPath, GCancellable *cancellable, QString *error);
+    RemoteCatalog listRefs(const QByteArray &repoPath,
+                           const QByteArray &remote,
+                           GCancellable *cancellable);
+
+    QSet<GCancellable *> m_pending;
+    QThreadPool m_pool;
+    // 只读的 remote_list_refs 可以在多个线程中共用同一个仓库
+    QMutex m_repoMutex;
+    OstreeRepo *m_repo;
+    QByteArray m_repoPath;
+};
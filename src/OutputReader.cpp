@@ -0,0 +1,158 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "OutputReader.h"
+
+#include "FdStore.h"
+#include "Log.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include <memory>
+
+// 输出 socket 单行的最大长度
+static const int LINE_READER_CAPACITY = 64 * 1024;
+static const QByteArrayView PROGRESS_PREFIX = "progressRate:";
+
+OutputReader::OutputReader(int listRemoteRefsFd,
+                           int upgradeStdoutFd,
+                           const QByteArrayList &remotes)
+    : QObject(nullptr)
+    , m_listRemoteRefsFd(listRemoteRefsFd)
+    , m_upgradeStdoutFd(upgradeStdoutFd)
+    , m_listRemoteRefsStdoutServer(new QLocalServer(this))
+    , m_upgradeStdoutServer(new QLocalServer(this))
+    , m_check(0)
+    , m_listRemoteRefsSocket(nullptr)
+    , m_listRemoteRefsReader(LINE_READER_CAPACITY)
+    , m_remoteRefsParser(remotes)
+{
+}
+
+void OutputReader::start()
+{
+    // listen 创建的 socket notifier 属于调用的线程，必须在 I/O 线程中调用
+    m_listRemoteRefsStdoutServer->listen(m_listRemoteRefsFd);
+    connect(m_listRemoteRefsStdoutServer,
+            &QLocalServer::newConnection,
+            this,
+            &OutputReader::onListRemoteRefsConnection);
+
+    m_upgradeStdoutServer->listen(m_upgradeStdoutFd);
+    connect(m_upgradeStdoutServer, &QLocalServer::newConnection, this, [this] {
+        while (auto *socket = m_upgradeStdoutServer->nextPendingConnection()) {
+            // 存入 fd store，守护进程重启后可以继续读取升级的输出
+            FdStore::store(socket->socketDescriptor(), DUM_FDNAME_UPGRADE_CONNECTION);
+            attachUpgradeStdout(socket);
+        }
+    });
+}
+
+void OutputReader::expectListRemoteRefs(quint64 check)
+{
+    cancelListRemoteRefs();
+    m_check = check;
+}
+
+void OutputReader::cancelListRemoteRefs()
+{
+    if (m_listRemoteRefsSocket) {
+        m_listRemoteRefsSocket->disconnect(this);
+        m_listRemoteRefsSocket->abort();
+        m_listRemoteRefsSocket->deleteLater();
+        m_listRemoteRefsSocket = nullptr;
+    }
+    m_listRemoteRefsReader.reset();
+    m_remoteRefsParser.reset();
+    m_check = 0;
+}
+
+void OutputReader::restoreUpgradeStdout(int fd)
+{
+    auto *socket = new QLocalSocket(this);
+    if (!socket->setSocketDescriptor(fd, QLocalSocket::ConnectedState, QIODevice::ReadOnly)) {
+        qCWarning(logIo) << "Restore upgrade stdout failed:" << socket->errorString();
+        FdStore::remove(DUM_FDNAME_UPGRADE_CONNECTION);
+        socket->deleteLater();
+        return;
+    }
+    // 重启前未读取的输出仍在 socket 中，进入事件循环后继续读取
+    attachUpgradeStdout(socket);
+}
+
+void OutputReader::onListRemoteRefsConnection()
+{
+    while (auto *socket = m_listRemoteRefsStdoutServer->nextPendingConnection()) {
+        if (m_check == 0 || m_listRemoteRefsSocket) {
+            qCWarning(logIo) << "Unexpected list-remote-refs connection, dropped";
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+
+        emit listRemoteRefsConnected(m_check);
+        m_listRemoteRefsSocket = socket;
+        // 限制 socket 的内部缓冲区，数据按块交给解析器
+        socket->setReadBufferSize(LINE_READER_CAPACITY);
+        connect(socket, &QLocalSocket::readyRead, this, &OutputReader::readListRemoteRefsOutput);
+        connect(socket, &QLocalSocket::disconnected, this, [this] {
+            readListRemoteRefsOutput();
+            m_listRemoteRefsReader.finish([this](QByteArrayView line) {
+                m_remoteRefsParser.parseLine(line);
+            });
+            auto check = m_check;
+            auto parser = m_remoteRefsParser;
+            cancelListRemoteRefs();
+            emit listRemoteRefsFinished(check, parser);
+        });
+    }
+}
+
+void OutputReader::readListRemoteRefsOutput()
+{
+    m_listRemoteRefsReader.readFrom(m_listRemoteRefsSocket, [this](QByteArrayView line) {
+        m_remoteRefsParser.parseLine(line);
+    });
+}
+
+void OutputReader::attachUpgradeStdout(QLocalSocket *socket)
+{
+    // 限制 socket 的内部缓冲区，超长的行由 LineReader 丢弃
+    socket->setReadBufferSize(LINE_READER_CAPACITY);
+    auto reader = std::make_shared<LineReader>(LINE_READER_CAPACITY);
+    auto handler = [this](QByteArrayView line) {
+        parseUpgradeStdoutLine(line);
+    };
+    connect(socket, &QLocalSocket::readyRead, this, [socket, reader, handler] {
+        reader->readFrom(socket, handler);
+    });
+    connect(socket, &QLocalSocket::disconnected, this, [socket, reader, handler] {
+        reader->readFrom(socket, handler);
+        reader->finish(handler);
+        if (reader->overlongLines() > 0) {
+            qCWarning(logIo) << "Upgrade stdout dropped" << reader->overlongLines()
+                             << "overlong lines";
+        }
+        FdStore::remove(DUM_FDNAME_UPGRADE_CONNECTION);
+        socket->deleteLater();
+    });
+}
+
+void OutputReader::parseUpgradeStdoutLine(QByteArrayView line)
+{
+    if (line.startsWith(PROGRESS_PREFIX)) {
+        auto tmp = line.sliced(PROGRESS_PREFIX.size()).trimmed();
+        auto colonIdx = tmp.indexOf(':');
+        if (colonIdx == -1) {
+            return;
+        }
+        auto percent = tmp.first(colonIdx).trimmed().toFloat();
+        auto stage = tmp.sliced(colonIdx + 1).trimmed();
+
+        QElapsedTimer parsed;
+        parsed.start();
+        emit upgradeProgress(stage.toByteArray(), percent, parsed);
+    }
+}
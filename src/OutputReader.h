@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "LineReader.h"
+#include "RemoteRefsParser.h"
+
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QElapsedTimer>
+#include <QObject>
+
+class QLocalServer;
+class QLocalSocket;
+
+// 在独立的 I/O 线程中接受并读取 dum-list-remote-refs 和 dum-upgrade 的输出，按行解析后
+// 通过 queued 信号交给 D-Bus 线程，大量的升级输出和耗时的方法调用不会互相阻塞。
+// 对象创建后调用 moveToThread，公开的槽函数都通过 QMetaObject::invokeMethod 调用。
+class OutputReader : public QObject
+{
+    Q_OBJECT
+public:
+    OutputReader(int listRemoteRefsFd, int upgradeStdoutFd, const QByteArrayList &remotes);
+
+public slots:
+    // 在 I/O 线程中开始监听
+    void start();
+    // 接受编号为 check 的检查的输出连接，之前的连接被丢弃
+    void expectListRemoteRefs(quint64 check);
+    void cancelListRemoteRefs();
+    // 读取重启前存入 fd store 的升级输出连接
+    void restoreUpgradeStdout(int fd);
+
+signals:
+    void listRemoteRefsConnected(quint64 check);
+    void listRemoteRefsFinished(quint64 check, const RemoteRefsParser &parser);
+    // parsed 在解析时开始计时，用于统计转发到 D-Bus 线程的延迟
+    void upgradeProgress(const QByteArray &stage, float percent, const QElapsedTimer &parsed);
+
+private:
+    void onListRemoteRefsConnection();
+    void readListRemoteRefsOutput();
+    void attachUpgradeStdout(QLocalSocket *socket);
+    void parseUpgradeStdoutLine(QByteArrayView line);
+
+    int m_listRemoteRefsFd;
+    int m_upgradeStdoutFd;
+    QLocalServer *m_listRemoteRefsStdoutServer;
+    QLocalServer *m_upgradeStdoutServer;
+    // 0 表示没有等待输出的检查
+    quint64 m_check;
+    QLocalSocket *m_listRemoteRefsSocket;
+    LineReader m_listRemoteRefsReader;
+    RemoteRefsParser m_remoteRefsParser;
+};
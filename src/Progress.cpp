@@ -0,0 +1,26 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "Progress.h"
+
+QDBusArgument &operator<<(QDBusArgument &argument, const Progress &progress)
+{
+    argument.beginStructure();
+    argument << progress.stage << progress.percent;
+    argument.endStructure();
+
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, Progress &progress)
+{
+    argument.beginStructure();
+    argument >> progress.stage;
+    double d;
+    argument >> d;
+    progress.percent = d;
+    argument.endStructure();
+
+    return argument;
+}
@@ -0,0 +1,19 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QDBusArgument>
+#include <QMetaType>
+#include <QString>
+
+struct Progress
+{
+    QString stage;
+    float percent;
+};
+Q_DECLARE_METATYPE(Progress)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const Progress &progress);
+const QDBusArgument &operator>>(const QDBusArgument &argument, Progress &progress);
@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ProgressCoalescer.h"
+
+#include <cmath>
+
+ProgressCoalescer::ProgressCoalescer(double maxRate, double minDelta, QObject *parent)
+    : QObject(parent)
+    , m_maxRate(maxRate)
+    , m_minDelta(minDelta)
+    , m_pendingTimer(new QTimer(this))
+    , m_hasLast(false)
+    , m_hasPending(false)
+    , m_received(0)
+    , m_emitted(0)
+{
+    m_pendingTimer->setSingleShot(true);
+    connect(m_pendingTimer, &QTimer::timeout, this, &ProgressCoalescer::flushPending);
+}
+
+void ProgressCoalescer::push(const Progress &progress)
+{
+    m_received++;
+
+    if (!m_hasLast || progress.stage != m_last.stage || progress.percent >= 100) {
+        send(progress);
+        return;
+    }
+
+    if (std::fabs(progress.percent - m_last.percent) < m_minDelta) {
+        return;
+    }
+
+    if (m_maxRate > 0) {
+        auto interval = qint64(1000 / m_maxRate);
+        auto elapsed = m_lastSent.elapsed();
+        if (elapsed < interval) {
+            // 窗口内只保留最新的进度，被覆盖的计入 suppressed
+            m_pending = progress;
+            m_hasPending = true;
+            if (!m_pendingTimer->isActive()) {
+                m_pendingTimer->start(int(interval - elapsed));
+            }
+            return;
+        }
+    }
+
+    send(progress);
+}
+
+void ProgressCoalescer::reset()
+{
+    m_pendingTimer->stop();
+    m_hasLast = false;
+    m_hasPending = false;
+}
+
+void ProgressCoalescer::send(const Progress &progress)
+{
+    m_pendingTimer->stop();
+    m_hasPending = false;
+
+    m_last = progress;
+    m_hasLast = true;
+    m_lastSent.start();
+    m_emitted++;
+    emit progressReady(progress);
+}
+
+void ProgressCoalescer::flushPending()
+{
+    if (m_hasPending) {
+        send(m_pending);
+    }
+}
@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "Progress.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+// 合并高频的升级进度，限制 progress 信号的发送频率。
+// 阶段变化和 100% 总是立即发送；同一阶段内变化小于 minDelta 的进度被丢弃，
+// 超过频率限制的进度只保留最新的一个，在下一个发送窗口发送。
+class ProgressCoalescer : public QObject
+{
+    Q_OBJECT
+public:
+    // maxRate 为每秒最多发送的次数，为 0 时不限制；minDelta 为百分比
+    ProgressCoalescer(double maxRate, double minDelta, QObject *parent = nullptr);
+
+    void push(const Progress &progress);
+    // 新的升级开始时调用，清除上次发送的进度
+    void reset();
+
+    double maxRate() const { return m_maxRate; }
+
+    double minDelta() const { return m_minDelta; }
+
+    // 未发送的进度数量
+    quint64 suppressed() const { return m_received - m_emitted; }
+
+signals:
+    void progressReady(const Progress &progress);
+
+private:
+    void send(const Progress &progress);
+    void flushPending();
+
+    double m_maxRate;
+    double m_minDelta;
+    QTimer *m_pendingTimer;
+    QElapsedTimer m_lastSent;
+    Progress m_last;
+    Progress m_pending;
+    bool m_hasLast;
+    bool m_hasPending;
+    quint64 m_received;
+    quint64 m_emitted;
+};
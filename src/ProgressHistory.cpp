@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ProgressHistory.h"
+
+#include <QDBusMetaType>
+#include <QDateTime>
+
+#include <cstring>
+
+#include <time.h>
+
+QDBusArgument &operator<<(QDBusArgument &argument, const ProgressHistoryRecord &record)
+{
+    argument.beginStructure();
+    argument << record.sequence << record.timestamp << record.stage << record.percent;
+    argument.endStructure();
+
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, ProgressHistoryRecord &record)
+{
+    argument.beginStructure();
+    argument >> record.sequence >> record.timestamp >> record.stage >> record.percent;
+    argument.endStructure();
+
+    return argument;
+}
+
+static qint64 monotonicNow()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return qint64(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+ProgressHistory::ProgressHistory()
+    : m_nextSequence(1)
+    , m_count(0)
+{
+}
+
+void ProgressHistory::registerMetaTypes()
+{
+    qDBusRegisterMetaType<ProgressHistoryRecord>();
+    qDBusRegisterMetaType<QList<ProgressHistoryRecord>>();
+}
+
+void ProgressHistory::append(QByteArrayView stage, float percent)
+{
+    auto &entry = m_entries[m_nextSequence % DUM_PROGRESS_HISTORY_SIZE];
+    entry.sequence = m_nextSequence++;
+    entry.timestamp = QDateTime::currentMSecsSinceEpoch();
+    entry.monotonic = monotonicNow();
+    entry.percent = percent;
+    entry.stageSize = qMin<qsizetype>(stage.size(), sizeof(entry.stage));
+    std::memcpy(entry.stage, stage.data(), entry.stageSize);
+
+    if (m_count < DUM_PROGRESS_HISTORY_SIZE) {
+        m_count++;
+    }
+}
+
+void ProgressHistory::clear()
+{
+    // 序号继续递增，客户端用旧的序号查询时不会拿到新一轮升级之前的记录
+    m_count = 0;
+}
+
+const ProgressHistory::Entry &ProgressHistory::at(int index) const
+{
+    // index 为 0 时为最旧的一条
+    auto sequence = m_nextSequence - m_count + index;
+    return m_entries[sequence % DUM_PROGRESS_HISTORY_SIZE];
+}
+
+QList<ProgressHistoryRecord> ProgressHistory::since(quint64 sequence) const
+{
+    QList<ProgressHistoryRecord> records;
+    for (int i = 0; i < m_count; i++) {
+        const auto &entry = at(i);
+        if (entry.sequence <= sequence) {
+            continue;
+        }
+
+        records.append({ entry.sequence,
+                         entry.timestamp,
+                         QString::fromUtf8(entry.stage, entry.stageSize),
+                         entry.percent });
+    }
+
+    return records;
+}
+
+QVariantMap ProgressHistory::stageDurations() const
+{
+    QVariantMap durations;
+    if (m_count == 0) {
+        return durations;
+    }
+
+    // 每个阶段从其第一条记录开始，到下一个阶段的第一条记录结束
+    int start = 0;
+    for (int i = 1; i <= m_count; i++) {
+        const auto &first = at(start);
+        QByteArrayView stage(first.stage, first.stageSize);
+        if (i < m_count) {
+            const auto &entry = at(i);
+            if (QByteArrayView(entry.stage, entry.stageSize) == stage) {
+                continue;
+            }
+        }
+
+        auto end = i < m_count ? at(i).monotonic : monotonicNow();
+        auto key = QString::fromUtf8(stage);
+        durations.insert(key, durations.value(key).toLongLong() + (end - first.monotonic));
+        start = i;
+    }
+
+    return durations;
+}
@@ -0,0 +1,69 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArrayView>
+#include <QDBusArgument>
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QVariantMap>
+
+#include <array>
+
+// 保留的进度记录数量
+#define DUM_PROGRESS_HISTORY_SIZE 256
+#define DUM_PROGRESS_HISTORY_STAGE_SIZE 64
+
+// getProgressHistory 返回的一条记录
+struct ProgressHistoryRecord
+{
+    quint64 sequence;
+    // 自 1970 年起的毫秒数
+    qint64 timestamp;
+    QString stage;
+    double percent;
+};
+Q_DECLARE_METATYPE(ProgressHistoryRecord)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const ProgressHistoryRecord &record);
+const QDBusArgument &operator>>(const QDBusArgument &argument, ProgressHistoryRecord &record);
+
+// 最近的升级进度，保存在固定大小的环形缓冲区中，记录时不分配内存
+class ProgressHistory
+{
+public:
+    ProgressHistory();
+
+    static void registerMetaTypes();
+
+    void append(QByteArrayView stage, float percent);
+    // 新的升级开始时调用
+    void clear();
+
+    // 序号大于 since 的记录，从旧到新排列
+    QList<ProgressHistoryRecord> since(quint64 sequence) const;
+    // 各阶段的耗时（毫秒）。最早的阶段的开始可能已被覆盖，此时其耗时偏小；
+    // 最后一个阶段计算到当前时间
+    QVariantMap stageDurations() const;
+
+private:
+    struct Entry
+    {
+        quint64 sequence;
+        qint64 timestamp;
+        qint64 monotonic;
+        float percent;
+        quint8 stageSize;
+        char stage[DUM_PROGRESS_HISTORY_STAGE_SIZE];
+    };
+
+    const Entry &at(int index) const;
+
+    std::array<Entry, DUM_PROGRESS_HISTORY_SIZE> m_entries;
+    // 下一条记录的序号，从 1 开始
+    quint64 m_nextSequence;
+    int m_count;
+};
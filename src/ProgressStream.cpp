@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ProgressStream.h"
+
+#include "Log.h"
+
+#include <QSocketNotifier>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+ProgressStream::ProgressStream(QObject *parent)
+    : QObject(parent)
+    , m_hasRecord(false)
+{
+    std::memset(&m_record, 0, sizeof(m_record));
+}
+
+ProgressStream::~ProgressStream()
+{
+    for (auto it = m_subscribers.cbegin(); it != m_subscribers.cend(); ++it) {
+        close(it.key());
+    }
+}
+
+int ProgressStream::subscribe(const QString &owner)
+{
+    if (m_subscribers.size() >= DUM_PROGRESS_STREAM_SUBSCRIBER_LIMIT) {
+        qCWarning(logIo) << "Too many progress subscribers";
+        return -1;
+    }
+    int owned = 0;
+    for (const auto &subscriber : std::as_const(m_subscribers)) {
+        if (subscriber.owner == owner) {
+            owned++;
+        }
+    }
+    if (owned >= DUM_PROGRESS_STREAM_OWNER_LIMIT) {
+        qCWarning(logIo) << "Too many progress subscribers of" << owner;
+        return -1;
+    }
+
+    // O_NONBLOCK 属于打开的文件，只设置在本端，订阅者可以阻塞读取。本端的发送另有 MSG_DONTWAIT
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+        qCWarning(logIo) << "Create progress stream failed:" << strerror(errno);
+        return -1;
+    }
+    int fd = fds[0];
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+        qCWarning(logIo) << "Set progress stream non-blocking failed:" << strerror(errno);
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    // 订阅者只读。订阅者关闭 fd 或误写入数据后本端变为可读，借此及时移除
+    auto *notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, [this, fd] {
+        drop(fd);
+    });
+    m_subscribers.insert(fd, { notifier, owner });
+
+    if (m_hasRecord && !send(fd)) {
+        drop(fd);
+        close(fds[1]);
+        return -1;
+    }
+
+    return fds[1];
+}
+
+void ProgressStream::dropOwner(const QString &owner)
+{
+    const auto fds = m_subscribers.keys();
+    for (int fd : fds) {
+        if (m_subscribers.value(fd).owner == owner) {
+            drop(fd);
+        }
+    }
+}
+
+void ProgressStream::publish(QByteArrayView stage, float percent)
+{
+    fillRecord(stage, percent);
+    if (m_subscribers.isEmpty()) {
+        return;
+    }
+
+    const auto fds = m_subscribers.keys();
+    for (int fd : fds) {
+        if (!send(fd)) {
+            drop(fd);
+        }
+    }
+}
+
+void ProgressStream::reset()
+{
+    m_hasRecord = false;
+}
+
+void ProgressStream::fillRecord(QByteArrayView stage, float percent)
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    m_record.sequence++;
+    m_record.percent = percent;
+    m_record.timestamp = quint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    m_record.stageSize = qMin<qsizetype>(stage.size(), sizeof(m_record.stage));
+    std::memcpy(m_record.stage, stage.data(), m_record.stageSize);
+    m_hasRecord = true;
+}
+
+bool ProgressStream::send(int fd)
+{
+    auto ret = ::send(fd, &m_record, sizeof(m_record), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (ret != ssize_t(sizeof(m_record))) {
+        // EAGAIN 表示订阅者跟不上，其它错误表示已断开
+        qCInfo(logIo) << "Drop progress subscriber:" << strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+void ProgressStream::drop(int fd)
+{
+    auto it = m_subscribers.find(fd);
+    if (it == m_subscribers.end()) {
+        return;
+    }
+
+    auto *notifier = it->notifier;
+    m_subscribers.erase(it);
+    notifier->setEnabled(false);
+    notifier->deleteLater();
+    close(fd);
+}
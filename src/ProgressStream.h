@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "Progress.h"
+
+#include <QByteArrayView>
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+class QSocketNotifier;
+
+// 订阅者允许的最大数量，以及同一 D-Bus 连接允许的数量
+#define DUM_PROGRESS_STREAM_SUBSCRIBER_LIMIT 16
+#define DUM_PROGRESS_STREAM_OWNER_LIMIT 2
+#define DUM_PROGRESS_STREAM_STAGE_SIZE 110
+
+// 写入订阅 fd 的进度记录，长度固定为 128 字节，使用本机字节序
+struct ProgressRecord
+{
+    // 自守护进程启动起递增，订阅后的第一条为当前进度的快照
+    quint32 sequence;
+    float percent;
+    // CLOCK_MONOTONIC，微秒
+    quint64 timestamp;
+    quint16 stageSize;
+    char stage[DUM_PROGRESS_STREAM_STAGE_SIZE];
+};
+static_assert(sizeof(ProgressRecord) == 128);
+
+// 通过 SOCK_SEQPACKET 的 socketpair 向订阅者逐条发送未经合并的升级进度，不经过 dbus-daemon。
+// 写入不阻塞，socket 缓冲区已满或已断开的订阅者直接移除。
+class ProgressStream : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ProgressStream(QObject *parent = nullptr);
+    ~ProgressStream() override;
+
+    // 为 D-Bus 连接 owner 创建订阅，返回交给订阅者的 fd，调用者负责关闭；失败时返回 -1。
+    // 交给订阅者的 fd 是阻塞的
+    int subscribe(const QString &owner);
+    // owner 断开连接后移除其所有订阅
+    void dropOwner(const QString &owner);
+    void publish(QByteArrayView stage, float percent);
+    // 新的升级开始时调用，清除当前进度
+    void reset();
+
+    int subscriberCount() const { return m_subscribers.size(); }
+
+private:
+    void fillRecord(QByteArrayView stage, float percent);
+    bool send(int fd);
+    void drop(int fd);
+
+    struct Subscriber
+    {
+        QSocketNotifier *notifier;
+        QString owner;
+    };
+
+    QHash<int, Subscriber> m_subscribers;
+    ProgressRecord m_record;
+    bool m_hasRecord;
+};
@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "RefCatalog.h"
+
+#include <algorithm>
+
+static bool newerThan(const Branch &a, const Branch &b)
+{
+    return a.compareVersion(b) > 0;
+}
+
+void RefCatalog::insert(const Branch &branch)
+{
+    Key key{ branch.project().toByteArray(),
+             branch.period().toByteArray(),
+             branch.component().toByteArray() };
+    auto &group = m_groups[key];
+
+    auto it = std::upper_bound(group.begin(), group.end(), branch, newerThan);
+    // 版本相同的分支排在 it 之前
+    for (auto prev = it; prev != group.begin();) {
+        --prev;
+        if (prev->compareVersion(branch) != 0) {
+            break;
+        }
+        if (prev->codeName() == branch.codeName()) {
+            return;
+        }
+    }
+    if (it - group.begin() >= DUM_REF_CATALOG_GROUP_LIMIT) {
+        return;
+    }
+
+    group.insert(it, branch);
+    if (group.size() > DUM_REF_CATALOG_GROUP_LIMIT) {
+        group.removeLast();
+    }
+}
+
+void RefCatalog::clear()
+{
+    m_groups.clear();
+}
+
+Branch RefCatalog::best(const Branch &current) const
+{
+    Branch result;
+    for (const auto &group : m_groups) {
+        // 组内第一个即为该组最新的分支
+        const auto &head = group.first();
+        if (current.valid() && !current.canUpgradeTo(head)) {
+            continue;
+        }
+        if (!result.valid() || newerThan(head, result)) {
+            result = head;
+        }
+    }
+
+    return result;
+}
+
+QList<Branch> RefCatalog::candidates(const Branch &current, int limit) const
+{
+    QList<Branch> result;
+    for (const auto &group : m_groups) {
+        for (const auto &branch : group) {
+            if (current.valid() && !current.canUpgradeTo(branch)) {
+                // 组内有序，后面的分支更旧
+                break;
+            }
+            result.append(branch);
+        }
+    }
+
+    std::stable_sort(result.begin(), result.end(), newerThan);
+    if (result.size() > limit) {
+        result.resize(limit);
+    }
+
+    return result;
+}
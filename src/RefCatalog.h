@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "Branch.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+#include <tuple>
+
+// 每个 (project, period, component) 分组保留的最新分支数量
+#define DUM_REF_CATALOG_GROUP_LIMIT 16
+
+// 按 (project, period, component) 分组保存远程分支，组内按版本从新到旧排序
+class RefCatalog
+{
+public:
+    // 已存在相同的分支时忽略，多个远程仓库的分支合并时保留先插入的
+    void insert(const Branch &branch);
+    void clear();
+
+    bool isEmpty() const { return m_groups.isEmpty(); }
+
+    // current 可升级到的最新分支；current 无效时返回所有分支中最新的一个
+    Branch best(const Branch &current) const;
+    // current 可升级到的分支，按版本从新到旧排序，最多返回 limit 个
+    QList<Branch> candidates(const Branch &current, int limit) const;
+
+private:
+    using Key = std::tuple<QByteArray, QByteArray, QByteArray>;
+
+    QMap<Key, QList<Branch>> m_groups;
+};
+
+// 单个远程仓库的检查结果
+struct RemoteCatalog
+{
+    QByteArray remote;
+    RefCatalog catalog;
+    int refCount = 0;
+    // 检查耗时（毫秒）
+    qint64 elapsed = 0;
+    QString error;
+};
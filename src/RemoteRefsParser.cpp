@@ -0,0 +1,99 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "RemoteRefsParser.h"
+
+#include "Log.h"
+
+RemoteRefsParser::RemoteRefsParser(const QByteArrayList &remotes)
+{
+    for (const auto &remote : remotes) {
+        m_catalogs.append({ remote });
+    }
+}
+
+void RemoteRefsParser::reset()
+{
+    m_lineCount = 0;
+    m_invalidCount = 0;
+    m_currentBranch = Branch();
+    for (auto &remote : m_catalogs) {
+        remote.catalog.clear();
+        remote.refCount = 0;
+    }
+}
+
+void RemoteRefsParser::parseLine(QByteArrayView line)
+{
+    line = line.trimmed();
+    if (line.isEmpty()) {
+        return;
+    }
+    m_lineCount++;
+
+    bool startsWithAsterisk = line.startsWith('*');
+    if (startsWithAsterisk) {
+        line = line.sliced(1).trimmed();
+    }
+
+    auto colonIdx = line.indexOf(' ');
+    if (colonIdx == -1) {
+        warnInvalid("ref", line);
+        return;
+    }
+
+    auto ref = line.first(colonIdx).trimmed();
+    auto remoteIdx = ref.indexOf(':');
+    if (remoteIdx == -1) {
+        warnInvalid("branch", ref);
+        return;
+    }
+    auto remote = ref.first(remoteIdx);
+    auto branch = ref.sliced(remoteIdx + 1).trimmed();
+
+    // 当前分支可能来自任意仓库，其它分支只保留配置的仓库
+    RemoteCatalog *catalog = nullptr;
+    for (auto &item : m_catalogs) {
+        if (item.remote == remote) {
+            catalog = &item;
+            break;
+        }
+    }
+    if (!catalog && !startsWithAsterisk) {
+        return;
+    }
+
+    Branch branchInfo(branch);
+    if (!branchInfo.valid()) {
+        warnInvalid("branch", branch);
+        return;
+    }
+
+    qCDebug(logRefs) << "Branch:" << branch;
+    if (startsWithAsterisk) {
+        m_currentBranch = branchInfo;
+        return;
+    }
+
+    catalog->refCount++;
+    catalog->catalog.insert(branchInfo);
+}
+
+void RemoteRefsParser::warnInvalid(const char *what, QByteArrayView value)
+{
+    // 输出中的分支可能有数千个，每 10 秒最多输出 5 条
+    static LogRateLimit limit(5, 10000);
+
+    m_invalidCount++;
+    quint64 suppressed;
+    if (!limit.allow(&suppressed)) {
+        return;
+    }
+    if (suppressed > 0) {
+        qCWarning(logRefs) << "Invalid" << what << value << "," << suppressed
+                           << "similar messages suppressed";
+    } else {
+        qCWarning(logRefs) << "Invalid" << what << value;
+    }
+}
@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "Branch.h"
+#include "RefCatalog.h"
+
+#include <QByteArrayList>
+#include <QByteArrayView>
+#include <QList>
+
+// 增量解析 deepin-immutable-ctl ota list-remote-refs 的输出。
+// 数据到达时即按行解析，只保留当前分支和每个分组中最新的若干分支，内存占用与输出大小无关。
+// 输出中包含所有远程仓库的分支，只保留 remotes 中的仓库，每个仓库分别记录。
+class RemoteRefsParser
+{
+public:
+    explicit RemoteRefsParser(const QByteArrayList &remotes);
+
+    void parseLine(QByteArrayView line);
+    void reset();
+
+    int lineCount() const { return m_lineCount; }
+
+    // 无法解析的行数，逐行的警告经过限频，由调用方输出汇总
+    int invalidCount() const { return m_invalidCount; }
+
+    const Branch &currentBranch() const { return m_currentBranch; }
+
+    // 按 remotes 的顺序排列
+    const QList<RemoteCatalog> &catalogs() const { return m_catalogs; }
+
+private:
+    void warnInvalid(const char *what, QByteArrayView value);
+
+    int m_lineCount = 0;
+    int m_invalidCount = 0;
+    Branch m_currentBranch;
+    QList<RemoteCatalog> m_catalogs;
+};
@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ResourceProfile.h"
+
+#include "Config.h"
+
+#include <QDBusMetaType>
+
+#include <limits>
+
+// systemd 的默认权重
+static const qulonglong DEFAULT_WEIGHT = 100;
+static const qulonglong BACKGROUND_WEIGHT = 20;
+
+QDBusArgument &operator<<(QDBusArgument &argument, const UnitProperty &property)
+{
+    argument.beginStructure();
+    argument << property.name << property.value;
+    argument.endStructure();
+
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, UnitProperty &property)
+{
+    argument.beginStructure();
+    argument >> property.name >> property.value;
+    argument.endStructure();
+
+    return argument;
+}
+
+void ResourceProfile::registerMetaTypes()
+{
+    qDBusRegisterMetaType<UnitProperty>();
+    qDBusRegisterMetaType<QList<UnitProperty>>();
+}
+
+bool ResourceProfile::isValid(const QString &profile)
+{
+    return profile == DUM_RESOURCE_PROFILE_BACKGROUND || profile == DUM_RESOURCE_PROFILE_FOREGROUND;
+}
+
+QVariantMap ResourceProfile::limits(const QString &profile)
+{
+    if (profile == DUM_RESOURCE_PROFILE_BACKGROUND) {
+        return {
+            { "CPUWeight", BACKGROUND_WEIGHT },
+            { "IOWeight", BACKGROUND_WEIGHT },
+            { "MemoryHigh", Config::instance().backgroundMemoryHigh() },
+        };
+    }
+
+    // MemoryHigh 为最大值时表示不限制
+    return {
+        { "CPUWeight", DEFAULT_WEIGHT },
+        { "IOWeight", DEFAULT_WEIGHT },
+        { "MemoryHigh", std::numeric_limits<qulonglong>::max() },
+    };
+}
+
+QList<UnitProperty> ResourceProfile::unitProperties(const QString &profile)
+{
+    QList<UnitProperty> properties;
+    auto values = limits(profile);
+    for (auto it = values.cbegin(); it != values.cend(); ++it) {
+        properties.append({ it.key(), QDBusVariant(it.value()) });
+    }
+
+    return properties;
+}
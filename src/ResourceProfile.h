@@ -0,0 +1,39 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QDBusArgument>
+#include <QDBusVariant>
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QVariantMap>
+
+#define DUM_RESOURCE_PROFILE_BACKGROUND "background"
+#define DUM_RESOURCE_PROFILE_FOREGROUND "foreground"
+
+// systemd SetUnitProperties 的参数 a(sv) 中的一项
+struct UnitProperty
+{
+    QString name;
+    QDBusVariant value;
+};
+Q_DECLARE_METATYPE(UnitProperty)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const UnitProperty &property);
+const QDBusArgument &operator>>(const QDBusArgument &argument, UnitProperty &property);
+
+// 升级 unit 的资源配置。
+// background 降低 CPU 和 IO 权重并设置内存的高水位，foreground 使用 systemd 的默认权重且不限制内存
+class ResourceProfile
+{
+public:
+    static void registerMetaTypes();
+
+    static bool isValid(const QString &profile);
+    // 资源限制，键为 systemd 的属性名
+    static QVariantMap limits(const QString &profile);
+    static QList<UnitProperty> unitProperties(const QString &profile);
+};
@@ -0,0 +1,206 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "StateStore.h"
+
+#include "Log.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <cstring>
+
+static const quint32 STATE_RECORD_MAGIC = 0x534d5544; // "DUMS"
+static const quint16 STATE_RECORD_VERSION = 1;
+
+// 文件中的记录，字段位置固定，读取时一次读入并校验
+struct StateRecord
+{
+    quint32 magic;
+    quint16 version;
+    quint8 upgradable;
+    quint8 stateSize;
+    char state[32];
+    quint16 remoteBranchSize;
+    char remoteBranch[512];
+    quint8 remoteSize;
+    char remote[64];
+    quint8 resourceProfileSize;
+    char resourceProfile[16];
+    quint32 restartCount;
+    qint64 interArrival;
+    qint64 lastRequest;
+    qint64 lastCheckTime;
+    quint32 checkFailures;
+    qint64 lastCheckFailure;
+};
+
+StateStore::StateStore(const QString &path, QObject *parent)
+    : QObject(parent)
+    , m_path(path)
+    , m_saveTimer(new QTimer(this))
+    , m_upgradable(false)
+    , m_restartCount(0)
+    , m_interArrival(0)
+    , m_lastRequest(0)
+    , m_lastCheckTime(0)
+    , m_checkFailures(0)
+    , m_lastCheckFailure(0)
+{
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(0);
+    connect(m_saveTimer, &QTimer::timeout, this, &StateStore::flush);
+}
+
+StateStore::~StateStore()
+{
+    if (m_saveTimer->isActive()) {
+        flush();
+    }
+}
+
+bool StateStore::load()
+{
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    StateRecord record;
+    if (file.read(reinterpret_cast<char *>(&record), sizeof(record)) != sizeof(record)) {
+        qCWarning(logDaemon) << "Invalid state file:" << m_path;
+        return false;
+    }
+
+    if (record.magic != STATE_RECORD_MAGIC || record.version != STATE_RECORD_VERSION
+        || record.stateSize > sizeof(record.state)
+        || record.remoteBranchSize > sizeof(record.remoteBranch)
+        || record.remoteSize > sizeof(record.remote)
+        || record.resourceProfileSize > sizeof(record.resourceProfile)) {
+        qCWarning(logDaemon) << "Invalid state file:" << m_path;
+        return false;
+    }
+
+    m_state = QString::fromUtf8(record.state, record.stateSize);
+    m_upgradable = record.upgradable;
+    m_remoteBranch = QString::fromUtf8(record.remoteBranch, record.remoteBranchSize);
+    m_remote = QString::fromUtf8(record.remote, record.remoteSize);
+    m_resourceProfile = QString::fromUtf8(record.resourceProfile, record.resourceProfileSize);
+    m_restartCount = record.restartCount;
+    m_interArrival = record.interArrival;
+    m_lastRequest = record.lastRequest;
+    m_lastCheckTime = record.lastCheckTime;
+    m_checkFailures = record.checkFailures;
+    m_lastCheckFailure = record.lastCheckFailure;
+
+    return true;
+}
+
+void StateStore::setState(const QString &state)
+{
+    m_state = state;
+    scheduleSave();
+}
+
+void StateStore::setUpgradable(bool upgradable)
+{
+    m_upgradable = upgradable;
+    scheduleSave();
+}
+
+void StateStore::setRemoteBranch(const QString &remoteBranch)
+{
+    m_remoteBranch = remoteBranch;
+    scheduleSave();
+}
+
+void StateStore::setRemote(const QString &remote)
+{
+    m_remote = remote;
+    scheduleSave();
+}
+
+void StateStore::setResourceProfile(const QString &resourceProfile)
+{
+    m_resourceProfile = resourceProfile;
+    scheduleSave();
+}
+
+void StateStore::setIdleStats(quint32 restartCount, qint64 interArrival, qint64 lastRequest)
+{
+    m_restartCount = restartCount;
+    m_interArrival = interArrival;
+    m_lastRequest = lastRequest;
+    scheduleSave();
+}
+
+void StateStore::setCheckStats(qint64 lastCheckTime,
+                               quint32 checkFailures,
+                               qint64 lastCheckFailure)
+{
+    m_lastCheckTime = lastCheckTime;
+    m_checkFailures = checkFailures;
+    m_lastCheckFailure = lastCheckFailure;
+    scheduleSave();
+}
+
+void StateStore::scheduleSave()
+{
+    if (!m_saveTimer->isActive()) {
+        m_saveTimer->start();
+    }
+}
+
+void StateStore::flush()
+{
+    m_saveTimer->stop();
+
+    auto state = m_state.toUtf8();
+    auto remoteBranch = m_remoteBranch.toUtf8();
+    auto remote = m_remote.toUtf8();
+    auto resourceProfile = m_resourceProfile.toUtf8();
+
+    StateRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.magic = STATE_RECORD_MAGIC;
+    record.version = STATE_RECORD_VERSION;
+    record.upgradable = m_upgradable;
+    record.stateSize = qMin<qsizetype>(state.size(), sizeof(record.state));
+    std::memcpy(record.state, state.constData(), record.stateSize);
+    if (remoteBranch.size() > qsizetype(sizeof(record.remoteBranch))) {
+        qCWarning(logDaemon) << "Remote branch too long, not saved:" << m_remoteBranch;
+    } else {
+        record.remoteBranchSize = remoteBranch.size();
+        std::memcpy(record.remoteBranch, remoteBranch.constData(), record.remoteBranchSize);
+    }
+    if (remote.size() > qsizetype(sizeof(record.remote))) {
+        qCWarning(logDaemon) << "Remote name too long, not saved:" << m_remote;
+    } else {
+        record.remoteSize = remote.size();
+        std::memcpy(record.remote, remote.constData(), record.remoteSize);
+    }
+    record.resourceProfileSize =
+        qMin<qsizetype>(resourceProfile.size(), sizeof(record.resourceProfile));
+    std::memcpy(record.resourceProfile, resourceProfile.constData(), record.resourceProfileSize);
+    record.restartCount = m_restartCount;
+    record.interArrival = m_interArrival;
+    record.lastRequest = m_lastRequest;
+    record.lastCheckTime = m_lastCheckTime;
+    record.checkFailures = m_checkFailures;
+    record.lastCheckFailure = m_lastCheckFailure;
+
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(logDaemon) << "Open state file failed:" << m_path << file.errorString();
+        return;
+    }
+
+    file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    if (!file.commit()) {
+        qCWarning(logDaemon) << "Write state file failed:" << m_path << file.errorString();
+    }
+}
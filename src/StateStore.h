@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#define DUM_STATE_STORE_FILE "/run/dum/state/status"
+
+// 保存空闲退出前的状态，供下次启动时恢复。
+// 状态以固定布局的记录写入 /run/dum/state，系统重启后自动清除。同一轮事件循环中的多次修改
+// 合并为一次写入，写入时先写临时文件再重命名，进程崩溃时不会留下不完整的文件。
+class StateStore : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StateStore(const QString &path, QObject *parent = nullptr);
+    ~StateStore() override;
+
+    // 文件不存在或内容无效时返回 false
+    bool load();
+
+    const QString &state() const { return m_state; }
+
+    bool upgradable() const { return m_upgradable; }
+
+    const QString &remoteBranch() const { return m_remoteBranch; }
+
+    // remoteBranch 所在的远程仓库
+    const QString &remote() const { return m_remote; }
+
+    const QString &resourceProfile() const { return m_resourceProfile; }
+
+    // 空闲退出后重新启动的次数以及请求间隔的统计，见 Idle
+    quint32 restartCount() const { return m_restartCount; }
+
+    qint64 interArrival() const { return m_interArrival; }
+
+    qint64 lastRequest() const { return m_lastRequest; }
+
+    // 上次成功检查的时间，以及之后连续失败的次数和最近一次失败的时间（自 1970 年起的毫秒数）
+    qint64 lastCheckTime() const { return m_lastCheckTime; }
+
+    quint32 checkFailures() const { return m_checkFailures; }
+
+    qint64 lastCheckFailure() const { return m_lastCheckFailure; }
+
+    void setState(const QString &state);
+    void setUpgradable(bool upgradable);
+    void setRemoteBranch(const QString &remoteBranch);
+    void setRemote(const QString &remote);
+    void setResourceProfile(const QString &resourceProfile);
+    void setIdleStats(quint32 restartCount, qint64 interArrival, qint64 lastRequest);
+    void setCheckStats(qint64 lastCheckTime, quint32 checkFailures, qint64 lastCheckFailure);
+
+    // 立即写入未保存的修改
+    void flush();
+
+private:
+    void scheduleSave();
+
+    QString m_path;
+    QTimer *m_saveTimer;
+    QString m_state;
+    bool m_upgradable;
+    QString m_remoteBranch;
+    QString m_remote;
+    QString m_resourceProfile;
+    quint32 m_restartCount;
+    qint64 m_interArrival;
+    qint64 m_lastRequest;
+    qint64 m_lastCheckTime;
+    quint32 m_checkFailures;
+    qint64 m_lastCheckFailure;
+};
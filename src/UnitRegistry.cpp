@@ -0,0 +1,254 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "UnitRegistry.h"
+
+#include "Log.h"
+
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QTimer>
+
+static const QString SYSTEMD1_SERVICE = "org.freedesktop.systemd1";
+static const QString SYSTEMD1_UNIT_INTERFACE = "org.freedesktop.systemd1.Unit";
+static const QString PROPERTIES_INTERFACE = "org.freedesktop.DBus.Properties";
+
+UnitRegistry::UnitRegistry(org::freedesktop::systemd1::Manager *manager,
+                           const QDBusConnection &bus,
+                           QObject *parent)
+    : QObject(parent)
+    , m_manager(manager)
+    , m_bus(bus)
+    , m_stopWaiterSequence(0)
+{
+    connect(m_manager,
+            &org::freedesktop::systemd1::Manager::JobNew,
+            this,
+            &UnitRegistry::onJobNew);
+    connect(m_manager,
+            &org::freedesktop::systemd1::Manager::JobRemoved,
+            this,
+            &UnitRegistry::onJobRemoved);
+
+    // 订阅后 systemd 才会发送 unit 和 job 的变化信号
+    auto *watcher = new QDBusPendingCallWatcher(m_manager->Subscribe(), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [](QDBusPendingCallWatcher *w) {
+        w->deleteLater();
+        QDBusPendingReply<> reply = *w;
+        if (reply.isError()) {
+            qCWarning(logDaemon) << "Subscribe systemd failed:" << reply.error().message();
+        }
+    });
+}
+
+void UnitRegistry::acquire(const QString &name, Callback callback)
+{
+    auto it = m_units.find(name);
+    if (it != m_units.end()) {
+        if (it->ready) {
+            callback(it->proxy, {});
+        } else {
+            it->waiters.append(std::move(callback));
+        }
+        return;
+    }
+
+    m_units[name].waiters.append(std::move(callback));
+
+    auto *watcher = new QDBusPendingCallWatcher(m_manager->LoadUnit(name), this);
+    connect(watcher,
+            &QDBusPendingCallWatcher::finished,
+            this,
+            [this, name](QDBusPendingCallWatcher *w) {
+                w->deleteLater();
+                QDBusPendingReply<QDBusObjectPath> reply = *w;
+                if (reply.isError()) {
+                    fail(name,
+                         QString("LoadUnit %1 failed: %2").arg(name).arg(reply.error().message()));
+                    return;
+                }
+
+                track(name, reply.value().path());
+            });
+}
+
+QString UnitRegistry::activeState(const QString &name) const
+{
+    return m_units.value(name).activeState;
+}
+
+bool UnitRegistry::isRunning(const QString &name) const
+{
+    auto it = m_units.find(name);
+    if (it == m_units.end()) {
+        return false;
+    }
+
+    return it->jobs > 0 || it->activeState == "active" || it->activeState == "activating"
+        || it->activeState == "deactivating" || it->activeState == "reloading";
+}
+
+void UnitRegistry::waitForStop(const QString &name, int timeout, StopCallback callback)
+{
+    auto it = m_units.find(name);
+    if (it == m_units.end() || !isRunning(name)) {
+        callback(true);
+        return;
+    }
+
+    auto id = ++m_stopWaiterSequence;
+    it->stopWaiters.insert(id, std::move(callback));
+    QTimer::singleShot(timeout, this, [this, name, id] {
+        auto it = m_units.find(name);
+        if (it == m_units.end()) {
+            return;
+        }
+
+        auto callback = it->stopWaiters.take(id);
+        if (callback) {
+            callback(false);
+        }
+    });
+}
+
+void UnitRegistry::notifyStopped(const QString &name)
+{
+    auto it = m_units.find(name);
+    if (it == m_units.end() || it->stopWaiters.isEmpty() || isRunning(name)) {
+        return;
+    }
+
+    // 回调中可能再次等待，先取出当前的等待者
+    const auto waiters = std::exchange(it->stopWaiters, {});
+    for (const auto &callback : waiters) {
+        callback(true);
+    }
+}
+
+void UnitRegistry::track(const QString &name, const QString &path)
+{
+    m_units[name].proxy = new org::freedesktop::systemd1::Unit(SYSTEMD1_SERVICE, path, m_bus, this);
+    m_names.insert(path, name);
+
+    // 先订阅再读取初始状态，避免丢失两者之间的变化
+    m_bus.connect(SYSTEMD1_SERVICE,
+                  path,
+                  PROPERTIES_INTERFACE,
+                  "PropertiesChanged",
+                  this,
+                  SLOT(onPropertiesChanged(QDBusMessage)));
+
+    auto msg =
+        QDBusMessage::createMethodCall(SYSTEMD1_SERVICE, path, PROPERTIES_INTERFACE, "GetAll");
+    msg << SYSTEMD1_UNIT_INTERFACE;
+
+    auto *watcher = new QDBusPendingCallWatcher(m_bus.asyncCall(msg), this);
+    connect(watcher,
+            &QDBusPendingCallWatcher::finished,
+            this,
+            [this, name](QDBusPendingCallWatcher *w) {
+                w->deleteLater();
+                QDBusPendingReply<QVariantMap> reply = *w;
+                if (reply.isError()) {
+                    fail(name,
+                         QString("GetAll %1 failed: %2").arg(name).arg(reply.error().message()));
+                    return;
+                }
+
+                updateState(name, reply.value());
+
+                auto &entry = m_units[name];
+                entry.ready = true;
+                auto waiters = std::exchange(entry.waiters, {});
+                auto *proxy = entry.proxy;
+                for (const auto &callback : waiters) {
+                    callback(proxy, {});
+                }
+            });
+}
+
+void UnitRegistry::fail(const QString &name, const QString &error)
+{
+    auto entry = m_units.take(name);
+    if (entry.proxy) {
+        m_names.remove(entry.proxy->path());
+        m_bus.disconnect(SYSTEMD1_SERVICE,
+                         entry.proxy->path(),
+                         PROPERTIES_INTERFACE,
+                         "PropertiesChanged",
+                         this,
+                         SLOT(onPropertiesChanged(QDBusMessage)));
+        entry.proxy->deleteLater();
+    }
+
+    for (const auto &callback : entry.waiters) {
+        callback(nullptr, error);
+    }
+    for (const auto &callback : std::as_const(entry.stopWaiters)) {
+        callback(true);
+    }
+}
+
+void UnitRegistry::updateState(const QString &name, const QVariantMap &properties)
+{
+    auto it = m_units.find(name);
+    if (it == m_units.end()) {
+        return;
+    }
+
+    if (properties.contains("ActiveState")) {
+        auto activeState = properties.value("ActiveState").toString();
+        if (activeState != it->activeState) {
+            it->activeState = activeState;
+            emit activeStateChanged(name, activeState);
+            notifyStopped(name);
+        }
+    }
+}
+
+void UnitRegistry::onPropertiesChanged(const QDBusMessage &message)
+{
+    auto args = message.arguments();
+    if (args.size() < 2 || args.at(0).toString() != SYSTEMD1_UNIT_INTERFACE) {
+        return;
+    }
+
+    auto name = m_names.value(message.path());
+    if (name.isEmpty()) {
+        return;
+    }
+
+    updateState(name, qdbus_cast<QVariantMap>(args.at(1)));
+}
+
+void UnitRegistry::onJobNew(uint id, const QDBusObjectPath &job, const QString &unit)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(job);
+
+    auto it = m_units.find(unit);
+    if (it != m_units.end()) {
+        it->jobs++;
+    }
+}
+
+void UnitRegistry::onJobRemoved(uint id,
+                                const QDBusObjectPath &job,
+                                const QString &unit,
+                                const QString &result)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(job);
+
+    auto it = m_units.find(unit);
+    if (it == m_units.end()) {
+        return;
+    }
+
+    if (it->jobs > 0) {
+        it->jobs--;
+    }
+    emit jobRemoved(unit, job, result);
+    notifyStopped(unit);
+}
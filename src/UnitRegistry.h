@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "SystemdManagerInterface.h"
+#include "SystemdUnitInterface.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QObject>
+
+#include <functional>
+
+// 缓存 systemd unit 的代理和状态。
+// 每个 unit 只 LoadUnit 并读取一次状态，之后通过 PropertiesChanged 以及 JobNew/JobRemoved
+// 信号更新，查询 unit 是否在运行时不需要访问 systemd。
+class UnitRegistry : public QObject
+{
+    Q_OBJECT
+public:
+    // unit 为空时 error 为失败原因
+    using Callback =
+        std::function<void(org::freedesktop::systemd1::Unit *unit, const QString &error)>;
+    using StopCallback = std::function<void(bool stopped)>;
+
+    UnitRegistry(org::freedesktop::systemd1::Manager *manager,
+                 const QDBusConnection &bus,
+                 QObject *parent = nullptr);
+
+    // 获取 unit 的代理，首次获取时加载 unit 并读取状态，之后直接返回缓存的代理
+    void acquire(const QString &name, Callback callback);
+
+    QString activeState(const QString &name) const;
+    // unit 处于活动状态或者有未完成的任务
+    bool isRunning(const QString &name) const;
+    // unit 不在运行时调用 callback(true)；timeout 毫秒内仍在运行时调用 callback(false)。
+    // unit 的输出结束后，表示其停止的信号可能稍后才到达
+    void waitForStop(const QString &name, int timeout, StopCallback callback);
+
+signals:
+    void activeStateChanged(const QString &name, const QString &activeState);
+    // unit 的任务结束，result 为 done、failed 等。oneshot unit 的任务在进程退出后才结束，
+    // 比 ActiveState 回到 inactive 更适合判断其是否完成
+    void jobRemoved(const QString &name, const QDBusObjectPath &job, const QString &result);
+
+private slots:
+    void onPropertiesChanged(const QDBusMessage &message);
+    void onJobNew(uint id, const QDBusObjectPath &job, const QString &unit);
+    void onJobRemoved(uint id,
+                      const QDBusObjectPath &job,
+                      const QString &unit,
+                      const QString &result);
+
+private:
+    struct Entry
+    {
+        org::freedesktop::systemd1::Unit *proxy = nullptr;
+        bool ready = false;
+        QString activeState;
+        int jobs = 0;
+        QList<Callback> waiters;
+        // 按等待的先后排列
+        QMap<quint64, StopCallback> stopWaiters;
+    };
+
+    void track(const QString &name, const QString &path);
+    void fail(const QString &name, const QString &error);
+    void updateState(const QString &name, const QVariantMap &properties);
+    void notifyStopped(const QString &name);
+
+    org::freedesktop::systemd1::Manager *m_manager;
+    QDBusConnection m_bus;
+    QHash<QString, Entry> m_units;
+    QHash<QString, QString> m_names; // path -> name
+    quint64 m_stopWaiterSequence;
+};
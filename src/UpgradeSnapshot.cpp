@@ -0,0 +1,125 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "UpgradeSnapshot.h"
+
+#include "FdStore.h"
+#include "Log.h"
+
+#include <cstring>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static const quint32 SNAPSHOT_MAGIC = 0x53505544; // "DUPS"
+static const quint16 SNAPSHOT_VERSION = 2;
+
+struct SnapshotRecord
+{
+    quint32 magic;
+    quint16 version;
+    quint16 stageSize;
+    float percent;
+    char stage[128];
+    quint16 unitSize;
+    char unit[256];
+};
+
+UpgradeSnapshot::UpgradeSnapshot()
+    : m_fd(-1)
+    , m_progress{ {}, 0 }
+{
+}
+
+UpgradeSnapshot::~UpgradeSnapshot()
+{
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool UpgradeSnapshot::create(const QString &unit)
+{
+    discard();
+
+    int fd = memfd_create(DUM_FDNAME_UPGRADE_SNAPSHOT, MFD_CLOEXEC);
+    if (fd < 0) {
+        qCWarning(logUpgrade) << "memfd_create failed:" << strerror(errno);
+        return false;
+    }
+
+    m_fd = fd;
+    m_unit = unit;
+    m_progress = { {}, 0 };
+    write();
+
+    if (!FdStore::store(m_fd, DUM_FDNAME_UPGRADE_SNAPSHOT)) {
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+bool UpgradeSnapshot::restore(int fd)
+{
+    SnapshotRecord record;
+    if (pread(fd, &record, sizeof(record), 0) != sizeof(record) || record.magic != SNAPSHOT_MAGIC
+        || record.version != SNAPSHOT_VERSION || record.stageSize > sizeof(record.stage)
+        || record.unitSize > sizeof(record.unit)) {
+        qCWarning(logUpgrade) << "Invalid upgrade snapshot";
+        return false;
+    }
+
+    discard();
+    m_fd = fd;
+    m_unit = QString::fromUtf8(record.unit, record.unitSize);
+    m_progress = { QString::fromUtf8(record.stage, record.stageSize), record.percent };
+
+    return true;
+}
+
+void UpgradeSnapshot::update(const Progress &progress)
+{
+    if (m_fd < 0) {
+        return;
+    }
+
+    m_progress = progress;
+    write();
+}
+
+void UpgradeSnapshot::discard()
+{
+    if (m_fd < 0) {
+        return;
+    }
+
+    FdStore::remove(DUM_FDNAME_UPGRADE_SNAPSHOT);
+    close(m_fd);
+    m_fd = -1;
+}
+
+void UpgradeSnapshot::write()
+{
+    auto stage = m_progress.stage.toUtf8();
+    auto unit = m_unit.toUtf8();
+
+    SnapshotRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.magic = SNAPSHOT_MAGIC;
+    record.version = SNAPSHOT_VERSION;
+    record.percent = m_progress.percent;
+    record.stageSize = qMin<qsizetype>(stage.size(), sizeof(record.stage));
+    std::memcpy(record.stage, stage.constData(), record.stageSize);
+    record.unitSize = qMin<qsizetype>(unit.size(), sizeof(record.unit));
+    std::memcpy(record.unit, unit.constData(), record.unitSize);
+
+    if (pwrite(m_fd, &record, sizeof(record), 0) != sizeof(record)) {
+        qCWarning(logUpgrade) << "Write upgrade snapshot failed:" << strerror(errno);
+    }
+}
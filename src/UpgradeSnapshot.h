@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "Progress.h"
+
+#include <QString>
+
+// 进行中的升级的快照，保存在 memfd 中并存入 systemd fd store。
+// 升级过程中守护进程重启后，通过快照重新关联升级的 unit 并恢复进度。
+class UpgradeSnapshot
+{
+public:
+    UpgradeSnapshot();
+    ~UpgradeSnapshot();
+
+    UpgradeSnapshot(const UpgradeSnapshot &) = delete;
+    UpgradeSnapshot &operator=(const UpgradeSnapshot &) = delete;
+
+    // 为新的升级创建快照并存入 fd store
+    bool create(const QString &unit);
+    // 读取 fd store 中取回的快照，成功后接管 fd
+    bool restore(int fd);
+    // 原地更新快照中的进度，fd store 中的副本指向同一个文件，无需重新存入
+    void update(const Progress &progress);
+    // 升级结束，关闭快照并从 fd store 中移除
+    void discard();
+
+    bool valid() const { return m_fd >= 0; }
+
+    const QString &unit() const { return m_unit; }
+
+    const Progress &progress() const { return m_progress; }
+
+private:
+    void write();
+
+    int m_fd;
+    QString m_unit;
+    Progress m_progress;
+};
@@ -2,12 +2,16 @@
 //
 // SPDX-License-Identifier: GPL-3.0-or-later
 
+#include "FdStore.h"
+#include "Log.h"
 #include "ManagerAdaptor.h"
 
 #include <systemd/sd-daemon.h>
 
 #include <QCoreApplication>
 #include <QDBusConnection>
+#include <QElapsedTimer>
+#include <QTimer>
 
 #include <string>
 #include <unordered_map>
@@ -30,26 +34,44 @@ static std::unordered_map<std::string, int> getFds()
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startTimer;
+    startTimer.start();
+
     auto fds = getFds();
     if (!fds.contains(DUM_LIST_REMOTE_REFS_STDOUT)) {
-        qWarning() << DUM_LIST_REMOTE_REFS_STDOUT << " not found";
+        qCWarning(logDaemon) << DUM_LIST_REMOTE_REFS_STDOUT << " not found";
         return 1;
     }
     if (!fds.contains(DUM_UPGRADE_STDOUT)) {
-        qWarning() << DUM_UPGRADE_STDOUT << " not found";
+        qCWarning(logDaemon) << DUM_UPGRADE_STDOUT << " not found";
         return 1;
     }
 
     int dumListRemoteRefsStdoutFd = fds[DUM_LIST_REMOTE_REFS_STDOUT];
     int dumUpgradeStdoutFd = fds[DUM_UPGRADE_STDOUT];
+    // 重启前存入 fd store 的进行中的升级
+    int upgradeConnectionFd = fds.contains(DUM_FDNAME_UPGRADE_CONNECTION)
+        ? fds[DUM_FDNAME_UPGRADE_CONNECTION]
+        : -1;
+    int upgradeSnapshotFd =
+        fds.contains(DUM_FDNAME_UPGRADE_SNAPSHOT) ? fds[DUM_FDNAME_UPGRADE_SNAPSHOT] : -1;
 
     QCoreApplication a(argc, argv);
 
     QDBusConnection connection = QDBusConnection::systemBus();
 
     ManagerAdaptor adaptor(dumListRemoteRefsStdoutFd, dumUpgradeStdoutFd, connection);
+    adaptor.restoreUpgrade(upgradeConnectionFd, upgradeSnapshotFd);
     connection.registerService("org.deepin.UpdateManager1");
-    connection.registerObject(ADAPTOR_PATH, &adaptor, QDBusConnection::ExportScriptableContents);
+    connection.registerObject(ADAPTOR_PATH,
+                              &adaptor,
+                              QDBusConnection::ExportScriptableContents
+                                  | QDBusConnection::ExportAdaptors);
+
+    // 进入事件循环时冷启动完成
+    QTimer::singleShot(0, &adaptor, [&adaptor, &startTimer] {
+        adaptor.setColdStartCost(startTimer.elapsed());
+    });
 
     return a.exec();
 }